@@ -24,6 +24,8 @@
 
 #include <iostream>
 #include <array>
+#include <chrono>
+#include <cstdlib>
 
 #include "fc4sc.hpp"
 #include "test_type_1.hpp"
@@ -36,11 +38,42 @@ using fc4sc::intersection;
 template <typename T>
 void print_arr(std::vector<fc4sc::interval_t<T>> x) {
   for (auto it: x)
-    cerr << "[" << it.first << "," << it.second << "] ";
-  cerr << "\n";
+    std::cerr << "[" << it.first << "," << it.second << "] ";
+  std::cerr << "\n";
 }
 
-int main() {
+/*!
+ * Measures the average cost of sampling the covergroup and of sampling its
+ * cross alone, over values cycling through every bin of the coverpoints
+ */
+void benchmark(test_coverage& cvg, size_t iterations) {
+  const int values[] = { 0, 3, 7, 40, 99, 255, 1000 };
+  const size_t num_values = sizeof(values) / sizeof(values[0]);
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i)
+    cvg.sample(values[i % num_values], i & 1, (i >> 1) & 1);
+  auto stop = std::chrono::steady_clock::now();
+  double cvg_ns = std::chrono::duration<double, std::nano>(stop - start).count();
+
+  // the cross reads the bins hit by the last covergroup sample, so sampling
+  // it repeatedly after each covergroup sample isolates its own cost
+  const size_t repeat = 16;
+  double cross_ns = 0;
+  for (size_t i = 0; i < iterations / repeat; ++i) {
+    cvg.sample(values[i % num_values], i & 1, (i >> 1) & 1);
+    start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < repeat; ++r)
+      cvg.reset_valid_cross.sample();
+    stop = std::chrono::steady_clock::now();
+    cross_ns += std::chrono::duration<double, std::nano>(stop - start).count();
+  }
+
+  std::cout << "covergroup sample: " << cvg_ns / iterations << " ns\n";
+  std::cout << "cross sample:      " << cross_ns / (iterations / repeat * repeat) << " ns\n";
+}
+
+int main(int argc, char** argv) {
 
   array<test_coverage, 1> test_array;    
 
@@ -53,6 +86,10 @@ int main() {
   test_array[0].sample(80,1,1);
   test_array[0].sample(100,1,1);
 
-  fc4sc::global::coverage_save("results.xml");
+  xml_printer::coverage_save("results.xml");
+
+  size_t iterations = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  test_coverage timed;
+  benchmark(timed, iterations);
 
 }
@@ -0,0 +1,155 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+
+/*
+ * Measures the cost of sampling one covergroup instance from several threads:
+ *  - plain:   one thread, no synchronization (the baseline)
+ *  - mutex:   every sample() call holds a mutex
+ *  - sharded: every thread samples into its own shard (set_shards)
+ *  - atomic:  lock-free sampling with relaxed atomic counters, only available
+ *             when built with FC4SC_ATOMIC_COUNTERS
+ * Each mode checks that no sample was lost.
+ *
+ * Usage: bench_plain|bench_atomic [threads] [samples per thread]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "fc4sc.hpp"
+
+// Values read by the sample expressions, private to each sampling thread
+static thread_local int opcode = 0;
+static thread_local int operand = 0;
+
+class bench_cvg : public covergroup {
+public:
+  CG_CONS(bench_cvg) { }
+
+  COVERPOINT(int, opcode_cvp, opcode) {
+    bin_array<int>("op", 16, interval(0,15))
+  };
+
+  COVERPOINT(int, operand_cvp, operand) {
+    bin<int>("zero", 0),
+    bin_array<int>("small", 8, interval(1,255)),
+    bin<int>("large", interval(256,65535))
+  };
+
+  cross<int,int> opcode_operand = cross<int,int>(this, "opcode_operand", &opcode_cvp, &operand_cvp);
+};
+
+/*! Samples the covergroup n times with values generated from seed */
+template <typename Sample>
+static void sample_loop(size_t seed, size_t n, Sample sample)
+{
+  uint32_t x = 2463534242u + seed;
+  for (size_t i = 0; i < n; ++i) {
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    opcode = x & 15;
+    operand = (x >> 4) & 0xffff;
+    sample();
+  }
+}
+
+/*!
+ * Total hit count of the opcode coverpoint, equal to the number of samples,
+ * or 0 if the cross counted a different number of samples
+ */
+static uint64_t total_hits(bench_cvg& cvg)
+{
+  uint64_t total = 0, cross_total = 0;
+  for (uint32_t i = 0; i < cvg.opcode_cvp.size(); ++i)
+    total += cvg.opcode_cvp.get_bin_hit_count(i);
+  cvg.opcode_operand.for_each_cross_bin([&cross_total](const size_t*, uint64_t count) {
+    cross_total += count;
+  });
+  return (total == cross_total) ? total : 0;
+}
+
+/*! Runs a sampling mode and prints its cost per sample */
+template <typename Setup, typename Sample>
+static bool run(const char* mode, size_t threads, size_t samples, Setup setup, Sample sample)
+{
+  auto cntxt = fc4sc::global::create_new_context();
+  bool ok;
+  {
+    bench_cvg cvg("cvg", __FILE__, __LINE__, cntxt);
+    setup(cvg);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+      workers.emplace_back([&cvg, &sample, t, samples]() { sample(cvg, t, samples); });
+    for (auto& w : workers) w.join();
+    auto stop = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    uint64_t expected = threads * samples;
+    uint64_t hits = total_hits(cvg);
+    ok = (hits == expected);
+    std::cout << mode << ": " << threads << " thread(s), "
+              << ns / expected << " ns/sample, "
+              << hits << "/" << expected << " samples counted"
+              << (ok ? "" : " MISMATCH") << "\n";
+  }
+  fc4sc::global::delete_context(cntxt);
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  size_t threads = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4;
+  size_t samples = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+  bool ok = true;
+
+  auto no_setup = [](bench_cvg&) { };
+
+  ok &= run("plain", 1, threads * samples, no_setup,
+    [](bench_cvg& cvg, size_t t, size_t n) {
+      sample_loop(t, n, [&cvg]() { cvg.sample(); });
+    });
+
+  std::mutex mutex;
+  ok &= run("mutex", threads, samples, no_setup,
+    [&mutex](bench_cvg& cvg, size_t t, size_t n) {
+      sample_loop(t, n, [&cvg, &mutex]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cvg.sample();
+      });
+    });
+
+#ifdef FC4SC_ATOMIC_COUNTERS
+  ok &= run("atomic", threads, samples, no_setup,
+    [](bench_cvg& cvg, size_t t, size_t n) {
+      sample_loop(t, n, [&cvg]() { cvg.sample(); });
+    });
+#else
+  ok &= run("sharded", threads, samples,
+    [threads](bench_cvg& cvg) { cvg.set_shards(threads); },
+    [](bench_cvg& cvg, size_t t, size_t n) {
+      fc4sc::set_thread_shard(t);
+      sample_loop(t, n, [&cvg]() { cvg.sample(); });
+    });
+#endif
+
+  return ok ? 0 : 1;
+}
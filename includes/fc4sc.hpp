@@ -49,6 +49,9 @@ namespace fc4sc {
 #include "fc4sc_base.hpp"
 #include "fc4sc_master.hpp"
 #include "fc4sc_intervals.hpp"
+#include "fc4sc_index.hpp"
+#include "fc4sc_cross_storage.hpp"
+#include "fc4sc_sample_queue.hpp"
 #include "fc4sc_options.hpp"
 #include "fc4sc_binsof.hpp"
 #include "fc4sc_bin.hpp"
@@ -62,6 +65,9 @@ using fc4sc::interval;
 using fc4sc::bin;
 using fc4sc::bin_array;
 using fc4sc::binsof;
+using fc4sc::cross_bin;
+using fc4sc::ignore_cross_bin;
+using fc4sc::illegal_cross_bin;
 using fc4sc::ignore_bin;
 using fc4sc::illegal_bin;
 using fc4sc::coverpoint;
@@ -46,8 +46,62 @@
 #include <unordered_map>
 #include <assert.h>
 #include <memory>
+#include <atomic>
+#include <sstream>
+#include <cstdlib>
+#include <climits>
+#include <mutex>
 
 #include "fc4sc_options.hpp"
+#include "fc4sc_sample_queue.hpp"
+
+/*!
+ * \brief Validity checks done when sampling
+ *
+ * Every coverage object holds a weak reference to its coverage data and, by
+ * default, checks that the data still exists each time it is sampled. The
+ * checks can be reduced for release builds (NDEBUG defined):
+ *  - FC4SC_CHECK_PER_COVERGROUP: the data is checked once per covergroup
+ *    sample. Coverpoints, crosses and bins sampled on behalf of the covergroup
+ *    are not checked again; their data is owned by the covergroup data.
+ *  - FC4SC_UNCHECKED: no checks on the sampling paths at all.
+ * Builds without NDEBUG always do every check.
+ */
+#if defined(NDEBUG) && defined(FC4SC_UNCHECKED)
+#define FC4SC_CHECK_ON_CVG_SAMPLE 0
+#define FC4SC_CHECK_ON_MEMBER_SAMPLE 0
+#elif defined(NDEBUG) && defined(FC4SC_CHECK_PER_COVERGROUP)
+#define FC4SC_CHECK_ON_CVG_SAMPLE 1
+#define FC4SC_CHECK_ON_MEMBER_SAMPLE 0
+#else
+#define FC4SC_CHECK_ON_CVG_SAMPLE 1
+#define FC4SC_CHECK_ON_MEMBER_SAMPLE 1
+#endif
+
+/*!
+ * \brief Throws if the coverage data referenced by valid_data has been deleted
+ */
+#define FC4SC_CHECK_VALID_DATA(valid_data) \
+  do { \
+    if((valid_data).use_count() == 0) { \
+      std::cerr << "Error: coverage data has been deleted\n"; \
+      throw("Error: coverage data has been deleted"); \
+    } \
+  } while (0)
+
+/*! \brief Validity check at the start of a covergroup sample */
+#if FC4SC_CHECK_ON_CVG_SAMPLE
+#define FC4SC_CHECK_CVG_SAMPLE(valid_data) FC4SC_CHECK_VALID_DATA(valid_data)
+#else
+#define FC4SC_CHECK_CVG_SAMPLE(valid_data) do { } while (0)
+#endif
+
+/*! \brief Validity check when sampling a coverpoint, cross or bin */
+#if FC4SC_CHECK_ON_MEMBER_SAMPLE
+#define FC4SC_CHECK_MEMBER_SAMPLE(valid_data) FC4SC_CHECK_VALID_DATA(valid_data)
+#else
+#define FC4SC_CHECK_MEMBER_SAMPLE(valid_data) do { } while (0)
+#endif
 
 /*
  * Template meta-programming tool used for checking that a parameter
@@ -167,19 +221,62 @@ template<typename forbidden, typename first> struct forbid_type<forbidden, first
  */
 #define COVERPOINT(...) GET_CVP_MACRO(__VA_ARGS__, CVP_4, CVP_3)(__VA_ARGS__)
 
+/*
+ * Macro that declares the member function sampling coverpoint cvp_name. It
+ * evaluates the sample condition and, if met, stores the sample expression
+ * in its argument. Being a member function of the covergroup, its body is
+ * compiled with the concrete types of the expressions and can be inlined
+ * in the sampling thunk registered with the coverpoint.
+ */
+#define CVP_SAMPLE_FN(val_type, cvp_name, sample_expr, sample_cond) \
+        bool fc4sc_sample_##cvp_name(val_type& fc4sc_val) { \
+          if (!(sample_cond)) return false; \
+          fc4sc_val = (sample_expr); \
+          return true; \
+        }
+
+/*
+ * Macro that creates the sampling thunk of coverpoint cvp_name, together with
+ * the covergroup pointer it is called with.
+ */
+#define CVP_SAMPLE_THUNK(val_type, cvp_name) \
+        &covergroup::sample_thunk<typename std::remove_pointer<decltype(this)>::type, val_type, \
+          &std::remove_pointer<decltype(this)>::type::fc4sc_sample_##cvp_name>, this
+
+/*
+ * Macro that gets the schema of the bins of coverpoint cvp_name, shared by
+ * all instances of the covergroup type.
+ */
+#define CVP_SCHEMA(val_type, cvp_name) \
+        covergroup::cvp_schema<typename std::remove_pointer<decltype(this)>::type, val_type, \
+          &std::remove_pointer<decltype(this)>::type::fc4sc_sample_##cvp_name>()
+
+/*
+ * Macro that registers coverpoint cvp_name. COVERPOINT expands it in both
+ * branches of a conditional whose last branch is assigned the bins: once the
+ * schema is built, the bins following the macro are not evaluated.
+ */
+#define CVP_REGISTER(type, cvp_name, sample_expr, sample_expr_str, sample_cond, sample_cond_str) \
+        covergroup::register_cvp<type>(&cvp_name, #cvp_name, \
+        CREATE_WRAP_F(sample_expr, type), sample_expr_str, \
+        CREATE_WRAP_F(sample_cond, bool), sample_cond_str, \
+        CVP_SAMPLE_THUNK(type, cvp_name), &CVP_SCHEMA(type, cvp_name))
+
 // COVERPOINT macro for 3 arguments (no sample condition)
 #define CVP_3(type, cvp_name, sample_expr) \
+        CVP_SAMPLE_FN(type, cvp_name, sample_expr, true) \
         coverpoint<type> cvp_name = \
-        covergroup::register_cvp<type>(&cvp_name, #cvp_name, \
-        CREATE_WRAP_F(sample_expr, type), #sample_expr, \
-        CREATE_WRAP_F(true, bool), std::string("")) =
+        covergroup::schema_built<type>(CVP_SCHEMA(type, cvp_name)) ? \
+        CVP_REGISTER(type, cvp_name, sample_expr, #sample_expr, true, std::string("")) : \
+        CVP_REGISTER(type, cvp_name, sample_expr, #sample_expr, true, std::string("")) =
 
 // COVERPOINT macro for 4 arguments (sample condition included)
 #define CVP_4(type, cvp_name, sample_expr, sample_cond) \
+        CVP_SAMPLE_FN(type, cvp_name, sample_expr, sample_cond) \
         coverpoint<type> cvp_name = \
-        covergroup::register_cvp<type>(&cvp_name, #cvp_name, \
-        CREATE_WRAP_F(sample_expr, type), #sample_expr, \
-        CREATE_WRAP_F(sample_cond, bool), #sample_cond) =
+        covergroup::schema_built<type>(CVP_SCHEMA(type, cvp_name)) ? \
+        CVP_REGISTER(type, cvp_name, sample_expr, #sample_expr, sample_cond, #sample_cond) : \
+        CVP_REGISTER(type, cvp_name, sample_expr, #sample_expr, sample_cond, #sample_cond) =
 
 // global var for type name and instance name of default scopes
 // covergroups that are not associated with user-defined scopes automatically are associated with the default scope
@@ -261,6 +358,250 @@ public:
 
 };
 
+/*!
+ * \brief Shard the calling thread samples into
+ *
+ * Each thread sampling a sharded covergroup concurrently must use its own
+ * shard. Threads which never call set_thread_shard() use shard 0.
+ */
+inline size_t& thread_shard()
+{
+  static thread_local size_t shard = 0;
+  return shard;
+}
+
+/*!
+ * \brief Selects the shard the calling thread samples into
+ * \param shard Shard index, taken modulo the shard count of each covergroup
+ */
+inline void set_thread_shard(size_t shard)
+{
+  thread_shard() = shard;
+}
+
+#ifdef FC4SC_ATOMIC_COUNTERS
+/*!
+ *  \class counter_t fc_base.hpp
+ *  \brief Hit counter updated with relaxed atomic operations
+ *
+ *  With FC4SC_ATOMIC_COUNTERS defined, all hit counters and miss counters are
+ *  of this type, so several threads can sample the same covergroup instance
+ *  concurrently. Only the counts themselves are atomic, no ordering is
+ *  implied between different counters. Unlike std::atomic it can be copied,
+ *  which lets it be stored in standard containers.
+ */
+class counter_t {
+
+  std::atomic<uint64_t> value;
+
+public:
+
+  counter_t(uint64_t v = 0) : value(v) { }
+
+  counter_t(const counter_t& rh) : value(rh.load()) { }
+
+  counter_t& operator=(const counter_t& rh)
+  {
+    value.store(rh.load(), std::memory_order_relaxed);
+    return *this;
+  }
+
+  counter_t& operator=(uint64_t v)
+  {
+    value.store(v, std::memory_order_relaxed);
+    return *this;
+  }
+
+  uint64_t load() const { return value.load(std::memory_order_relaxed); }
+
+  operator uint64_t() const { return load(); }
+
+  /*! Adds n to the counter and returns the new count */
+  uint64_t add(uint64_t n) { return value.fetch_add(n, std::memory_order_relaxed) + n; }
+
+  counter_t& operator+=(uint64_t n) { add(n); return *this; }
+
+  counter_t& operator++() { add(1); return *this; }
+
+  uint64_t operator++(int) { return add(1) - 1; }
+
+};
+
+/*! Increments a counter and returns the new count */
+inline uint64_t count_hit(counter_t& counter)
+{
+  return counter.add(1);
+}
+
+/*! Adds n hits to a counter and returns the new count */
+inline uint64_t count_hits(counter_t& counter, uint64_t n)
+{
+  return counter.add(n);
+}
+#else
+/*! Hit counter type. Plain integer unless FC4SC_ATOMIC_COUNTERS is defined */
+typedef uint64_t counter_t;
+
+/*! Increments a counter and returns the new count */
+inline uint64_t count_hit(counter_t& counter)
+{
+  return ++counter;
+}
+
+/*! Adds n hits to a counter and returns the new count */
+inline uint64_t count_hits(counter_t& counter, uint64_t n)
+{
+  return counter += n;
+}
+#endif
+
+/*! Converts a bin count for the int overloads, saturating at INT_MAX */
+inline int saturate_to_int(uint64_t count)
+{
+  return count > static_cast<uint64_t>(INT_MAX) ? INT_MAX : static_cast<int>(count);
+}
+
+/*!
+ * \brief Regular bins hit by one sample, in the order they were hit. Holds
+ * up to FC4SC_MAX_HIT_BINS bins, inline so that sampling does not allocate
+ */
+struct bin_hit_list {
+  size_t count;
+  size_t bins[FC4SC_MAX_HIT_BINS];
+  /*! Set when a bin was dropped because the list was full */
+  bool truncated;
+
+  void clear() { count = 0; truncated = false; }
+
+  /*! Records a hit bin, dropped if the list is full */
+  void push(size_t bin)
+  {
+    if (count < FC4SC_MAX_HIT_BINS) bins[count++] = bin;
+    else truncated = true;
+  }
+
+  bool empty() const { return count == 0; }
+
+  size_t size() const { return count; }
+
+  size_t operator[](size_t i) const { return bins[i]; }
+};
+
+/*!
+ * \brief Result of sampling one coverpoint or cross
+ */
+struct cvp_sample_result {
+  bin_hit_list bins_hit;
+  bool last_sample_success;
+};
+
+/*!
+ * \brief Sample results of the covergroup sample running on the calling
+ * thread, indexed by the slot of each coverpoint or cross. Null outside of
+ * covergroup sampling and unless FC4SC_ATOMIC_COUNTERS is defined
+ */
+inline cvp_sample_result*& call_results()
+{
+  static thread_local cvp_sample_result* results = nullptr;
+  return results;
+}
+
+/*!
+ * \brief Publishes the sample results of a covergroup sample to the calling
+ * thread for its lifetime
+ */
+class call_results_scope {
+
+  cvp_sample_result* previous;
+
+public:
+
+  explicit call_results_scope(cvp_sample_result* results) : previous(call_results())
+  {
+    call_results() = results;
+  }
+
+  ~call_results_scope()
+  {
+    call_results() = previous;
+  }
+
+  call_results_scope(const call_results_scope&) = delete;
+  call_results_scope& operator=(const call_results_scope&) = delete;
+
+};
+
+/*!
+ *  \class counter_span fc_base.hpp
+ *  \brief View over the hit counts of the intervals of one bin
+ *
+ *  The counters of all the bins of a coverpoint are stored back to back in one
+ *  array owned by the coverpoint data. A bin refers to its slice of the array
+ *  by offset, so views stay valid when the array grows. When sampling is
+ *  sharded, every shard has an array with the same layout and the view
+ *  returns the counts summed over all of them.
+ */
+class counter_span {
+
+  const std::vector<counter_t>* store;
+  const std::vector<std::vector<counter_t>>* shards;
+  size_t offset;
+  size_t count;
+
+public:
+
+  /*! Iterator over the hit counts of the view */
+  class const_iterator {
+
+    const counter_span* span;
+    size_t i;
+
+  public:
+
+    typedef std::input_iterator_tag iterator_category;
+    typedef uint64_t value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const uint64_t* pointer;
+    typedef uint64_t reference;
+
+    const_iterator(const counter_span* span, size_t i) : span(span), i(i) { }
+
+    uint64_t operator*() const { return (*span)[i]; }
+
+    const_iterator& operator++() { ++i; return *this; }
+
+    const_iterator operator++(int) { const_iterator it = *this; ++i; return it; }
+
+    bool operator==(const const_iterator& rh) const { return i == rh.i; }
+
+    bool operator!=(const const_iterator& rh) const { return i != rh.i; }
+
+  };
+
+  counter_span(const std::vector<counter_t>& store,
+               const std::vector<std::vector<counter_t>>* shards,
+               size_t offset, size_t count) :
+    store(&store), shards(shards), offset(offset), count(count) { }
+
+  /*! Hit count of interval i, over all shards */
+  uint64_t operator[](size_t i) const
+  {
+    uint64_t hits = (*store)[offset + i];
+    if (shards) {
+      for (auto& shard : *shards)
+        if (offset + i < shard.size()) hits += shard[offset + i];
+    }
+    return hits;
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+
+  const_iterator end() const { return const_iterator(this, count); }
+
+  size_t size() const { return count; }
+
+};
+
 /*!
  *  \class bin_base_data_model fc_base.hpp
  *  \brief Base class for bin_data_model class
@@ -272,7 +613,12 @@ class bin_base_data_model {
 public:
  
   /*! Indicates if the data within this object is valid */
-  std::shared_ptr<bool> valid = std::make_shared<bool>(true);
+  std::shared_ptr<bool> valid;
+
+  bin_base_data_model() : valid(std::make_shared<bool>(true)) { }
+
+  /*! Shares the valid flag of the data owning this bin */
+  explicit bin_base_data_model(const std::shared_ptr<bool>& owner_valid) : valid(owner_valid) { }
 
   /*! Get intervals in type int */
   virtual std::vector<interval_t<int>> get_intervals_to_int() const = 0;
@@ -284,7 +630,27 @@ public:
   virtual bin_t& get_bin_type() = 0;
 
   /*! Get hit count for each interval in bin */
-  virtual std::vector<uint64_t>& get_interval_hits() = 0;
+  virtual counter_span get_interval_hits() = 0;
+
+  /*!
+   * \brief Get hit count for each interval in bin, counted by a coverpoint
+   * whose bins are the bins of the coverpoint holding this bin
+   * \param counters Counter array of that coverpoint
+   * \param shards Shard counter arrays of that coverpoint
+   */
+  virtual counter_span get_interval_hits(const std::vector<counter_t>& counters,
+                                         const std::vector<std::vector<counter_t>>* shards) const = 0;
+
+  /*!
+   * \brief Creates the data of this bin for a coverpoint whose bins are the
+   * bins of the coverpoint holding this bin
+   * \param owner_valid Valid flag of the data of that coverpoint
+   * \param counters Counter array of that coverpoint
+   * \param shards Shard counter arrays of that coverpoint
+   */
+  virtual bin_base_data_model* create_instance(const std::shared_ptr<bool>& owner_valid,
+                                               std::vector<counter_t>& counters,
+                                               const std::vector<std::vector<counter_t>>& shards) const = 0;
 
   /*! Visitor Pattern for introspection */
   virtual void accept_visitor(covVisitorBase& visitor) = 0;
@@ -319,7 +685,7 @@ public:
   virtual bin_t& bin_type() = 0;
 
   /*! Get reference to bin counts */
-  virtual std::vector<uint64_t>& interval_hits() = 0;
+  virtual counter_span interval_hits() = 0;
 
   /*! Destructor */
   virtual ~bin_base(){}
@@ -372,7 +738,21 @@ public:
    * \param total Total number of bins in this instance
    * \returns Double between 0 and 100
    */
-  virtual double get_inst_coverage(int &hit, int &total) const = 0;
+  virtual double get_inst_coverage(uint64_t &hit, uint64_t &total) const = 0;
+
+  /*!
+   * \brief int version of get_inst_coverage(uint64_t&, uint64_t&), kept for
+   * source compatibility. Counts past INT_MAX are reported as INT_MAX. Derived
+   * classes bring it in scope with using api_base::get_inst_coverage
+   */
+  double get_inst_coverage(int &hit, int &total) const
+  {
+    uint64_t hit64 = 0, total64 = 0;
+    double res = get_inst_coverage(hit64, total64);
+    hit = saturate_to_int(hit64);
+    total = saturate_to_int(total64);
+    return res;
+  }
 
   /*!
    * \brief Enables sampling on this instance
@@ -392,6 +772,59 @@ public:
   virtual ~api_base(){}
 };
 
+/*!
+ * \brief Coverage of a covergroup instance, of a covergroup type or of a
+ * context, kept between queries
+ *
+ * Caches are chained from the instances up to the context. Whatever may
+ * change a coverage marks its cache and every cache above it as changed, so
+ * a query only recomputes the changed parts of the coverage model.
+ */
+struct coverage_cache
+{
+  /*! Set when the coverage must be recomputed */
+  std::atomic<bool> changed{true};
+
+  /*!
+   * Set when the levels below must be visited on every query, because some
+   * of their changes are not marked (sharded or asynchronous sampling)
+   */
+  bool uncached = false;
+
+  /*! Coverage percentage */
+  double coverage = 0;
+
+  /*! Number of covered bins */
+  uint64_t covered_bins = 0;
+
+  /*! Number of bins */
+  uint64_t total_bins = 0;
+
+  /*! Cache of the enclosing level, nullptr at the top */
+  coverage_cache* parent = nullptr;
+
+  /*! Marks this cache and the caches above it as changed */
+  void invalidate()
+  {
+    for (coverage_cache* cache = this; cache; cache = cache->parent)
+      cache->changed.store(true);
+  }
+
+  /*!
+   * \brief Checks if the coverage must be recomputed, clearing the changed
+   * mark. Changes marked while recomputing are seen by the next query
+   */
+  bool stale()
+  {
+    return changed.exchange(false) || uncached;
+  }
+};
+
+inline void invalidate_coverage(coverage_cache* cache)
+{
+  cache->invalidate();
+}
+
 /*!
  *  \class cvp_base_data_model fc_base.hpp
  *  \brief Base class for coverpoints and crosses
@@ -403,7 +836,100 @@ class cvp_base_data_model : public api_data_model
 public:
 
   /*! Number of sample misses (no bin hit)*/
-  uint64_t misses = 0;
+  counter_t misses = 0;
+
+  /*! Counter alone on its cache line */
+  struct padded_counter {
+    counter_t value = 0;
+    char pad[64 - sizeof(counter_t)];
+  };
+
+  /*! Misses of shards 1 and up. Empty unless sampling is sharded */
+  std::vector<padded_counter> shard_misses;
+
+  /*! Checks if sampling is sharded */
+  bool sharded() const
+  {
+    return !shard_misses.empty();
+  }
+
+  /*! Miss counter of a shard */
+  counter_t& shard_miss(size_t shard)
+  {
+    return shard ? shard_misses[shard - 1].value : misses;
+  }
+
+  /*! Number of sample misses over all shards */
+  uint64_t total_misses() const
+  {
+    uint64_t total = misses;
+    for (auto& shard : shard_misses)
+      total += shard.value;
+    return total;
+  }
+
+  /*!
+   * Number of samples whose hits were not all crossed: coverpoint values
+   * hitting more than FC4SC_MAX_HIT_BINS regular bins, or cross samples
+   * with more than option.max_hit_combinations combinations
+   */
+  std::atomic<uint64_t> truncated_samples{0};
+
+  /*!
+   * \brief Counts a truncated sample, the first one is reported on std::cerr
+   * \param what What was dropped
+   */
+  void sample_truncated(const char* what)
+  {
+    if (truncated_samples.fetch_add(1, std::memory_order_relaxed) == 0)
+      std::cerr << "Warning: " << name << " " << what << "\n";
+  }
+
+  /*!
+   * Sampling is cut back once the coverage reaches the goal. Set from the
+   * options when the covergroup plans its sampling
+   */
+  bool stop_at_goal = false;
+
+  /*! Sampling period once stop_at_goal triggered, 0 stops sampling */
+  uint32_t at_goal_sample_period = 0;
+
+  /*! Set once the coverage reached the goal with stop_at_goal set */
+  std::atomic<bool> goal_reached{false};
+
+  /*!
+   * Set once the covergroup cut back the sampling after goal_reached: the
+   * hit counts are no longer totals
+   */
+  bool sampling_cut = false;
+
+  /*!
+   * Number of objects planned by the covergroup sampling this one, reset
+   * when goal_reached is set so that the covergroup plans its sampling again
+   */
+  std::atomic<size_t>* sampling_planned = nullptr;
+
+  /*! Coverage cache of the covergroup instance holding this object */
+  coverage_cache* parent_coverage = nullptr;
+
+  /*! Marks the coverage of the covergroup instance as changed */
+  void coverage_changed()
+  {
+    if (parent_coverage) parent_coverage->invalidate();
+  }
+
+  /*!
+   * \brief Sets goal_reached once covered out of total bins reach the goal
+   * \param covered Number of covered bins
+   * \param total Number of bins
+   * \param goal Goal percentage
+   */
+  void check_goal(uint64_t covered, uint64_t total, uint64_t goal)
+  {
+    if (total == 0 || covered * 100 < goal * total) return;
+    if (goal_reached.exchange(true)) return;
+    if (sampling_planned) sampling_planned->store(0, std::memory_order_release);
+  }
 
   /*! Visitor function for introspection */
   virtual void accept_visitor(covVisitorBase&) = 0;
@@ -411,6 +937,9 @@ public:
   /*! Get coverpoint size */
   virtual uint64_t size() const = 0;
 
+  /*! Binds the options the coverage depends on to cache */
+  virtual void bind_options(coverage_cache* cache) = 0;
+
   /*! Destructor */
   virtual ~cvp_base_data_model() { }
 
@@ -428,9 +957,171 @@ protected:
   bool stop_sample_on_first_bin_hit = false;
 
 public:
-  size_t last_bin_index_hit = 0;
+  bin_hit_list last_bins_hit = bin_hit_list();
   bool last_sample_success = false;
 
+  /*! Result of the last sample of a shard other than 0 */
+  struct shard_sample_state {
+    bin_hit_list last_bins_hit = bin_hit_list();
+    bool last_sample_success = false;
+    /*! Keeps the states of different shards on different cache lines */
+    char pad[64];
+  };
+
+  /*! Sample results of shards 1 and up. Empty unless sampling is sharded */
+  std::vector<shard_sample_state> shard_states;
+
+  /*! Shard the calling thread samples into, 0 unless sampling is sharded */
+  size_t current_shard() const
+  {
+    return shard_states.empty() ? 0 : thread_shard() % (shard_states.size() + 1);
+  }
+
+  /*! Position of this object in its covergroup, set by the covergroup */
+  size_t cvg_slot = 0;
+
+  /*! Name of the covergroup sampling this object, set by the covergroup */
+  const std::string* cvg_name = nullptr;
+
+  /*!
+   * Object of a dynamic_covergroup_factory this object is an instance of,
+   * nullptr unless the covergroup is a dynamic_covergroup
+   */
+  const cvp_base* prototype = nullptr;
+
+  /*!
+   * Success of the last sample of a shard. During a covergroup sample with
+   * FC4SC_ATOMIC_COUNTERS defined, the result of the running sample instead
+   */
+  bool& sample_success(size_t shard)
+  {
+#ifdef FC4SC_ATOMIC_COUNTERS
+    if (cvp_sample_result* results = call_results())
+      return results[cvg_slot].last_sample_success;
+#endif
+    return shard ? shard_states[shard - 1].last_sample_success : last_sample_success;
+  }
+
+  /*!
+   * Regular bins hit by the last sample of a shard. During a covergroup
+   * sample with FC4SC_ATOMIC_COUNTERS defined, the bins hit by the running
+   * sample
+   */
+  bin_hit_list& bins_hit(size_t shard)
+  {
+#ifdef FC4SC_ATOMIC_COUNTERS
+    if (cvp_sample_result* results = call_results())
+      return results[cvg_slot].bins_hit;
+#endif
+    return shard ? shard_states[shard - 1].last_bins_hit : last_bins_hit;
+  }
+
+  /*! Last regular bin hit by the last sample of a shard */
+  size_t bin_index_hit(size_t shard)
+  {
+    bin_hit_list& hits = bins_hit(shard);
+    return hits.empty() ? 0 : hits[hits.size() - 1];
+  }
+
+  /*!
+   * \brief Builds everything sampling builds lazily, so that several threads
+   * can start sampling concurrently
+   */
+  virtual void prepare_sample() { }
+
+  /*!
+   * \brief Samples a group of objects sharing the dynamic type of this one
+   * \param cvps Objects to sample
+   * \param n Number of objects
+   * \param next Index of the next object to sample, left on the object that
+   * threw so that the caller can resume after it
+   */
+  typedef void (*sample_group_fn)(cvp_base* const* cvps, size_t n, size_t& next);
+
+  /*! Samples each object of a group through the virtual sample() */
+  static void sample_group_virtual(cvp_base* const* cvps, size_t n, size_t& next)
+  {
+    for (; next < n; ++next)
+      cvps[next]->sample();
+  }
+
+  /*!
+   * \brief Function sampling groups of objects of the dynamic type of this
+   * one. Types override it to sample without a virtual call per object
+   */
+  virtual sample_group_fn sample_group() const { return &cvp_base::sample_group_virtual; }
+
+  /*!
+   * \brief Worker thread counting the samples of the covergroup while it
+   * samples asynchronously, nullptr otherwise
+   */
+  sample_worker* async_worker = nullptr;
+
+  /*!
+   * \brief True if capture_sample() and sample_captured() can take the place
+   * of sample(), so the covergroup can sample asynchronously
+   */
+  virtual bool can_capture() const { return false; }
+
+  /*! Bytes written by capture_sample(), 0 for objects reading no value */
+  virtual size_t capture_size() const { return 0; }
+
+  /*!
+   * \brief Evaluates what sample() would count, without counting it
+   * \param record capture_size() bytes to copy the sampled value to
+   */
+  virtual void capture_sample(unsigned char* record) { (void)record; }
+
+  /*!
+   * \brief Counts a sample taken by capture_sample(). Objects reading no
+   * value count the results of the coverpoints they depend on
+   * \param record Bytes written by capture_sample()
+   */
+  virtual void sample_captured(const unsigned char* record) { (void)record; sample(); }
+
+  /*!
+   * \brief Looks up the values of several records in the sampling index at
+   * once, for sample_found_captured(). Objects reading no value do nothing
+   * \param records Value captured by this object in the first record
+   * \param stride Bytes between two records
+   * \param n Number of records
+   * \param pos Receives the lookup of each record, pos_stride apart
+   * \param pos_stride Distance between two lookups in pos
+   */
+  virtual void lookup_captured(const unsigned char* records, size_t stride, size_t n,
+                               size_t* pos, size_t pos_stride)
+  {
+    (void)records; (void)stride; (void)n; (void)pos; (void)pos_stride;
+  }
+
+  /*!
+   * \brief Counts a sample taken by capture_sample() whose lookup was done
+   * by lookup_captured()
+   * \param record Bytes written by capture_sample()
+   * \param pos Lookup of the record
+   */
+  virtual void sample_found_captured(const unsigned char* record, size_t pos)
+  {
+    (void)pos;
+    sample_captured(record);
+  }
+
+  /*!
+   * \brief Waits for the samples queued for the worker thread to be counted
+   * and ends the worker. Called by the destructors of the final types, so
+   * that the worker does not use objects being destroyed
+   */
+  void stop_async_worker()
+  {
+    if (async_worker) async_worker->stop();
+  }
+
+  /*!
+   * \brief Sets the number of shards sampled into
+   * \param shards Number of shards, 1 disables sharding
+   */
+  virtual void set_shards(size_t shards) = 0;
+
   virtual cvp_base* create_instance(cvg_base* cvg_inst) = 0;
 
   /*! Instance specific options */
@@ -462,7 +1153,11 @@ public:
   /*! Coverpoint options */
   cvp_option option;
 
-  /*! Vector of pointers to regular bin data */
+  /*!
+   * Vector of pointers to regular bin data. The bin data vectors of a
+   * coverpoint sharing its bins through schema_data are filled by
+   * create_bins_data()
+   */
   std::vector<bin_base_data_model*> bins_data;
 
   /*! Vector of pointers to illegal bin data */
@@ -471,6 +1166,124 @@ public:
   /*! Vector of pointers to ignore bin data */
   std::vector<bin_base_data_model*> ignore_bins_data;
 
+  /*!
+   * Data of the coverpoint holding the bins this coverpoint counts hits for,
+   * shared by the instances of a covergroup type. nullptr if the coverpoint
+   * holds its own bins. The bin data vectors above stay empty until
+   * create_bins_data() is called
+   */
+  const coverpoint_base_data_model* schema_data = nullptr;
+
+  /*! Regular bins of the coverpoint, holding the hits of schema_data if set */
+  const std::vector<bin_base_data_model*>& declared_bins() const
+  {
+    return schema_data ? schema_data->bins_data : bins_data;
+  }
+
+  /*! Number of regular bins */
+  size_t bin_count() const
+  {
+    return declared_bins().size();
+  }
+
+  /*!
+   * \brief Fills the bin data vectors of a coverpoint whose bins are shared
+   * through schema_data, for introspection. Nothing is done if they are
+   * filled already
+   */
+  void create_bins_data()
+  {
+    if (!schema_data || bins_data.size() + illegal_bins_data.size() + ignore_bins_data.size() != 0) return;
+    create_bins_data(schema_data->bins_data, bins_data);
+    create_bins_data(schema_data->illegal_bins_data, illegal_bins_data);
+    create_bins_data(schema_data->ignore_bins_data, ignore_bins_data);
+  }
+
+  /*! Creates the data of bins from the bins of schema_data */
+  void create_bins_data(const std::vector<bin_base_data_model*>& from, std::vector<bin_base_data_model*>& to)
+  {
+    to.reserve(from.size());
+    for (auto bin_it : from)
+      to.push_back(bin_it->create_instance(valid, hit_counters, shard_counters));
+  }
+
+  /*!
+   * Hit counters of the intervals of all bins (regular, illegal and ignore),
+   * each bin owning a contiguous slice
+   */
+  std::vector<counter_t> hit_counters;
+
+  /*!
+   * Hit counters of shards 1 and up, laid out like hit_counters. Empty unless
+   * sampling is sharded
+   */
+  std::vector<std::vector<counter_t>> shard_counters;
+
+  /*! Hit counter array of a shard */
+  std::vector<counter_t>& counters(size_t shard)
+  {
+    return shard ? shard_counters[shard - 1] : hit_counters;
+  }
+
+  /*!
+   * Total hit count of each regular bin, kept up to date by sampling unless
+   * sampling is sharded
+   */
+  std::vector<counter_t> bin_hits;
+
+  /*! Number of regular bins hit at least covered_at_least times */
+  counter_t covered_bins = 0;
+
+  /*! Value of option.at_least that covered_bins was counted for */
+  uint64_t covered_at_least = 0;
+
+  /*! Cleared when bin_hits and covered_bins must be recounted */
+  bool covered_valid = false;
+
+  /*!
+   * \brief Recounts bin_hits and covered_bins from the hit counters
+   */
+  void recount_covered()
+  {
+    const std::vector<bin_base_data_model*>& bins = declared_bins();
+    bin_hits.assign(bins.size(), 0);
+    covered_bins = 0;
+    covered_at_least = option.at_least;
+    for (size_t i = 0; i < bins.size(); ++i) {
+      for (auto hitcount : bins[i]->get_interval_hits(hit_counters, &shard_counters))
+        bin_hits[i] += hitcount;
+      covered_bins += (bin_hits[i] >= covered_at_least);
+    }
+    covered_valid = true;
+  }
+
+  /*!
+   * \brief Returns the number of regular bins hit at least option.at_least
+   * times. Only recounts if the bins or option.at_least changed, or if the
+   * counts of several shards must be combined
+   */
+  uint64_t get_covered_bins()
+  {
+    if (!covered_valid || covered_at_least != option.at_least || sharded()) recount_covered();
+    return covered_bins;
+  }
+
+  void bind_options(coverage_cache* cache)
+  {
+    option.bind(cache);
+  }
+
+  /*!
+   * \brief Counts a regular bin reaching covered_at_least hits while sampling
+   */
+  void bin_covered()
+  {
+    covered_bins++;
+    coverage_changed();
+    if (stop_at_goal && covered_at_least == option.at_least)
+      check_goal(covered_bins, bin_count(), option.goal);
+  }
+
   /*! Get reference to sample expression string */
   virtual std::string& get_sample_expression_str() = 0;
 
@@ -523,6 +1336,21 @@ public:
 
 };
 
+/*!
+ * \brief Hit count of a user-defined cross bin, for introspection
+ */
+struct cross_bin_hits
+{
+  /*! Name of the bin */
+  std::string name;
+
+  /*! Type of the bin (default/ignore/illegal) */
+  bin_t type;
+
+  /*! Number of samples in the bin */
+  uint64_t hits;
+};
+
 /*!
  *  \class cross_base_data_model fc_base.hpp
  *  \brief Base class for data of crosses
@@ -539,8 +1367,88 @@ public:
   /*! Vector of crossed coverpoints */
   std::vector<cvp_base_data_model*> cross_cvps;
 
-  /*! Get cross bins */
-  virtual const std::map<std::vector<size_t>, uint64_t>& get_cross_bins() const = 0;
+  /*!
+   * \brief Calls f(idx, count) once for every cross bin hit, idx pointing to
+   * one bin index per crossed coverpoint, in no particular order. Counts are
+   * combined over all shards; nothing is allocated unless sampling is sharded
+   */
+  virtual void for_each_cross_bin(const std::function<void(const size_t*, uint64_t)>& f) const = 0;
+
+  /*!
+   * \brief Get a copy of the hit cross bins, combined over all shards. This is
+   * a convenience for tests and tools: the map is built from the counters on
+   * every call, for_each_cross_bin() visits them without a copy
+   */
+  std::map<std::vector<size_t>, uint64_t> get_cross_bins() const
+  {
+    std::map<std::vector<size_t>, uint64_t> result;
+    const size_t arity = cross_cvps.size();
+    for_each_cross_bin([&result, arity](const size_t* idx, uint64_t count) {
+      result.emplace(std::vector<size_t>(idx, idx + arity), count);
+    });
+    return result;
+  }
+
+  /*!
+   * Get hit counts of the user-defined cross bins. The combinations they
+   * select are not part of get_cross_bins()
+   */
+  virtual std::vector<cross_bin_hits> get_user_bins() const = 0;
+
+  /*!
+   * \brief Lists the cross bins hit fewer than option.at_least times, in
+   * order of their bin indexes. User-defined bins are not listed
+   * \param max Maximum number of bins listed
+   */
+  virtual std::vector<std::vector<size_t>> get_missing_bins(size_t max) const = 0;
+
+  /*! Number of cross bins hit at least covered_at_least times */
+  counter_t covered_bins = 0;
+
+  /*! Value of option.at_least that covered_bins was counted for */
+  uint64_t covered_at_least = 0;
+
+  /*! Cleared when covered_bins must be recounted */
+  bool covered_valid = false;
+
+  /*!
+   * \brief Returns the number of cross bins hit at least option.at_least
+   * times. Only recounts if option.at_least changed, or if the counts of
+   * several shards must be combined
+   */
+  uint64_t get_covered_bins()
+  {
+    if (!covered_valid || covered_at_least != option.at_least || sharded()) {
+      covered_bins = 0;
+      covered_at_least = option.at_least;
+      uint64_t covered = 0;
+      const uint64_t at_least = covered_at_least;
+      for_each_cross_bin([&covered, at_least](const size_t*, uint64_t count) {
+        covered += (count >= at_least);
+      });
+      covered_bins = covered;
+      for (auto& bin : get_user_bins())
+        covered_bins += (bin.type == default_ && bin.hits >= std::max<uint64_t>(covered_at_least, 1));
+      covered_valid = true;
+    }
+    return covered_bins;
+  }
+
+  void bind_options(coverage_cache* cache)
+  {
+    option.bind(cache);
+  }
+
+  /*!
+   * \brief Counts a cross bin reaching covered_at_least hits while sampling
+   */
+  void bin_covered()
+  {
+    covered_bins++;
+    coverage_changed();
+    if (stop_at_goal && covered_valid && covered_at_least == option.at_least)
+      check_goal(covered_bins, size(), option.goal);
+  }
 
 };
 
@@ -557,12 +1465,24 @@ public:
   /*! Get reference to cross options */
   virtual cross_option& option() = 0;
 
-  /*! Get cross bins storage */
-  virtual const std::map<std::vector<size_t>, uint64_t>& get_cross_bins() const = 0;
+  /*!
+   * \brief Get a copy of the hit cross bins, built from the counters on every
+   * call. Prefer for_each_cross_bin() when a copy is not needed
+   */
+  virtual std::map<std::vector<size_t>, uint64_t> get_cross_bins() const = 0;
+
+  /*!
+   * \brief Calls f(idx, count) once for every cross bin hit, without
+   * building the map returned by get_cross_bins()
+   */
+  virtual void for_each_cross_bin(const std::function<void(const size_t*, uint64_t)>& f) const = 0;
 
   /*! Get crossed coverpoints storage */
   virtual const std::vector<cvp_base *>& get_cross_coverpoints() const = 0;
 
+  /*! Get the first max cross bins hit fewer than option().at_least times */
+  virtual std::vector<std::vector<size_t>> get_missing_bins(size_t max) const = 0;
+
   /*! Destructor */
   virtual ~cross_base() { }
 };
@@ -582,7 +1502,10 @@ friend class dynamic_covergroup;
 public:
 
   /*! Pointer for type data of the covergroup */
-  cvg_metadata* type_data;
+  cvg_metadata* type_data = nullptr;
+
+  /*! Coverage of the instance, chained to the coverage of its type */
+  coverage_cache coverage;
 
   /*! Indicator for optional covergroup */
   bool enable = true;
@@ -592,6 +1515,11 @@ public:
 
   /*! Instance specific options */
   cvg_option option;
+
+  cvg_base_data_model()
+  {
+    option.bind(&coverage);
+  }
   
   /*! File ID associated with the instance */
   unsigned int inst_file_id;
@@ -602,11 +1530,20 @@ public:
   /*! Pointer to data of parent scope instance */
   scp_base_data_model* parent_scp = nullptr;
 
+  /*!
+   * \brief Worker thread counting the samples of the covergroup while it
+   * samples asynchronously, nullptr otherwise
+   */
+  sample_worker* async_worker = nullptr;
+
 
   /*! Add coverpoint/cross data to the covergroup */
   void add_cvp_data(cvp_base_data_model* cvp_data)
   {
     cvps.push_back(cvp_data);
+    cvp_data->parent_coverage = &coverage;
+    cvp_data->bind_options(&coverage);
+    coverage.invalidate();
   }
   
   /*!
@@ -614,12 +1551,15 @@ public:
    */
   virtual void accept_visitor(covVisitorBase& visitor)
   {
+    // Samples still queued count before the data is looked at
+    if (async_worker) async_worker->drain();
     visitor.visit(*this);
   }
 
   /*! Destructor */
   virtual ~cvg_base_data_model()
   {
+    if (async_worker) async_worker->drain();
     for(auto cvp_it : cvps) {
       delete cvp_it;
     }
@@ -638,15 +1578,30 @@ class cvg_base : public api_base
 public:
 
   /*! get coverpoint reference by name within this covergroup*/ 
-  cvp_base& get_coverpoint(std::string name)
+  cvp_base& get_coverpoint(const std::string& name)
   {
-    for (auto& cvp : cvps)
-    {
-      if(name == cvp->name()) {
-        return *cvp;
-      }
-    }
-    throw("No coverpoint " + name + " in " + this->name());
+    cvp_base* cvp = find_coverpoint(name);
+    if (!cvp) throw("No coverpoint " + name + " in " + this->name());
+    return *cvp;
+  }
+
+  /*!
+   * \brief Finds a coverpoint or cross by name in a hash index of the names
+   * \returns The first object with this name, nullptr if there is none
+   */
+  cvp_base* find_coverpoint(const std::string& name)
+  {
+    std::lock_guard<std::mutex> lock(cvp_names_mutex);
+    auto found = cvp_names.find(name);
+    if (found != cvp_names.end() && found->second < cvps.size() && cvps[found->second]->name() == name)
+      return cvps[found->second];
+
+    // Objects were added or renamed since the index was built
+    cvp_names.clear();
+    for (size_t i = 0; i < cvps.size(); ++i)
+      cvp_names.emplace(cvps[i]->name(), i);
+    found = cvp_names.find(name);
+    return (found == cvp_names.end()) ? nullptr : cvps[found->second];
   }
 
   /*! Get pointer to covergroup data */
@@ -702,6 +1657,14 @@ public:
    */
   fc4sc::scp_base* parent_scp = nullptr;
 
+private:
+
+  /*! Position in cvps of the first object with each name */
+  std::unordered_map<std::string, size_t> cvp_names;
+
+  /*! Guards cvp_names */
+  std::mutex cvp_names_mutex;
+
 };
 
 /*!
@@ -916,6 +1879,14 @@ struct cvg_metadata
   /*! Vector of covergroup instances of this covergroup type */
   std::vector<cvg_base_data_model*> cvg_insts;
 
+  /*! Coverage of the type, chained to the coverage of its context */
+  coverage_cache coverage;
+
+  cvg_metadata()
+  {
+    type_option.bind(&coverage);
+  }
+
   /*! Destructor */
   virtual ~cvg_metadata()
   {
@@ -1005,6 +1976,155 @@ public:
   }
 };
 
+/*!
+ * \brief What sampling does when a value hits an illegal bin. The hit is
+ * counted in the illegal bin in every case
+ */
+enum class illegal_bin_action
+{
+  /*! Throws illegal_bin_sample_exception, the default */
+  throw_exception,
+  /*! Prints the message to std::cerr, the default with FC4SC_NO_THROW */
+  report,
+  /*! Only counts the hit */
+  count,
+  /*! Calls the callback of the policy */
+  callback,
+  /*! Prints the message to std::cerr and calls std::abort() */
+  abort
+};
+
+/*! Formats a sampled value of type T for the message of an illegal bin hit */
+template <typename T>
+std::string format_sample_value(const void* value)
+{
+  std::stringstream ss;
+  ss << *static_cast<const T*>(value);
+  return ss.str();
+}
+
+/*!
+ * \class illegal_bin_hit fc_base.hpp
+ * \brief Illegal bin hit handed to the illegal bin policy
+ *
+ * Only refers to the names and the value hit, the message is formatted when
+ * asked for. Valid during the policy call only.
+ */
+class illegal_bin_hit
+{
+  const void* value_hit;
+  std::string (*format_value)(const void*);
+
+public:
+
+  /*! Covergroup sampled, nullptr when sampling the coverpoint on its own */
+  const std::string* cvg_name;
+
+  /*! Coverpoint or cross sampled */
+  const std::string& cvp_name;
+
+  /*! Illegal bin hit */
+  const std::string& bin_name;
+
+  illegal_bin_hit(const std::string* cvg_name, const std::string& cvp_name, const std::string& bin_name,
+                  const void* value_hit, std::string (*format_value)(const void*))
+    : value_hit(value_hit), format_value(format_value), cvg_name(cvg_name), cvp_name(cvp_name), bin_name(bin_name)
+  {
+  }
+
+  /*! Value hit, formatted */
+  std::string value() const
+  {
+    return format_value(value_hit);
+  }
+
+  /*! Exception thrown for this hit by illegal_bin_action::throw_exception */
+  illegal_bin_sample_exception exception() const
+  {
+    illegal_bin_sample_exception e;
+    e.update_bin_info(bin_name, value());
+    e.update_cvp_info(cvp_name);
+    if (cvg_name) e.update_cvg_info(*cvg_name);
+    return e;
+  }
+
+  /*! Message describing this hit */
+  std::string message() const
+  {
+    return exception().what();
+  }
+};
+
+/*!
+ * \class illegal_bin_policy fc_base.hpp
+ * \brief What sampling does on illegal bin hits, for the whole process
+ */
+struct illegal_bin_policy
+{
+  illegal_bin_action action;
+
+  /*!
+   * Called by illegal_bin_action::callback, on the thread counting the
+   * sample. It may throw to stop the sample like throw_exception does; when
+   * sampling asynchronously, the exception is rethrown by the next sample()
+   */
+  std::function<void(const illegal_bin_hit&)> callback;
+
+  illegal_bin_policy()
+  {
+#ifdef FC4SC_NO_THROW
+    action = illegal_bin_action::report;
+#else
+    action = illegal_bin_action::throw_exception;
+#endif
+  }
+};
+
+/*! Illegal bin policy in use. Must not be changed while sampling */
+inline illegal_bin_policy& illegal_bins_policy()
+{
+  static illegal_bin_policy policy;
+  return policy;
+}
+
+/*!
+ * \brief Sets what sampling does on illegal bin hits
+ * \param action Action taken
+ * \param callback Called by illegal_bin_action::callback
+ */
+inline void set_illegal_bin_policy(illegal_bin_action action,
+                                   std::function<void(const illegal_bin_hit&)> callback = nullptr)
+{
+  illegal_bins_policy().action = action;
+  illegal_bins_policy().callback = callback;
+}
+
+/*!
+ * \brief Applies the illegal bin policy to a hit
+ *
+ * Returns unless the policy throws or aborts; the sample of the object then
+ * stops as if the value had hit no bin, without counting a miss.
+ */
+inline void handle_illegal_hit(const illegal_bin_hit& hit)
+{
+  const illegal_bin_policy& policy = illegal_bins_policy();
+  switch (policy.action) {
+  case illegal_bin_action::throw_exception:
+    throw hit.exception();
+  case illegal_bin_action::report:
+    std::cerr << hit.message() << std::endl;
+    break;
+  case illegal_bin_action::count:
+    break;
+  case illegal_bin_action::callback:
+    if (policy.callback) policy.callback(hit);
+    break;
+  case illegal_bin_action::abort:
+    std::cerr << hit.message() << std::endl;
+    std::abort();
+  }
+}
+
 } // namespace fc4sc
 
 #endif /* FC4SC_BASE_HPP */
@@ -61,6 +61,22 @@ static std::vector<interval_t<T>> intersection(const bin<T>& lhs, const bin<T>&
 template <typename T>
 static std::vector<interval_t<T>> intersection(const bin<T>& lhs, const std::vector<interval_t<T>>& rhs);
 
+/*!
+ * \brief Name and intervals of a bin. Shared by the bins of the coverpoints
+ * instanced from the same dynamic coverpoint, never changed once the bin is
+ * added to a coverpoint
+ * \tparam T Type of values in the bin
+ */
+template <class T>
+struct bin_definition
+{
+  /*! Name of the bin */
+  std::string name;
+
+  /*! Storage for the values. All are converted to intervals */
+  std::vector<interval_t<T>> intervals;
+};
+
 /*!
  * \brief Defines a class for bin data model
  * \tparam T Type of values in this bin
@@ -71,16 +87,149 @@ class bin_data_model : public bin_base_data_model
 public:
 
   // the type of bin (default/ignore/illegal)
-  bin_t bin_type;
+  bin_t bin_type = bin_t::default_;
 
-  /*! Storage for hit counts corresponding to intervals */
-  std::vector<uint64_t> interval_hits;
+  /*!
+   * Storage for hit counts corresponding to intervals, until the bin is added
+   * to a coverpoint. Afterwards the counts live in the coverpoint's counters
+   */
+  std::vector<counter_t> interval_hits;
 
-  /*! Storage for the values. All are converted to intervals */
-  std::vector<interval_t<T>> intervals;
+  /*! Name and intervals of the bin */
+  std::shared_ptr<bin_definition<T>> definition = std::make_shared<bin_definition<T>>();
+
+  /*! Array holding the hit counts: interval_hits or the coverpoint's counters */
+  std::vector<counter_t>* hits_store = &interval_hits;
+
+  /*! Position of the first hit count of this bin in hits_store */
+  size_t hits_offset = 0;
+
+  /*! Counter arrays of the other shards of the coverpoint, if sharded */
+  const std::vector<std::vector<counter_t>>* hits_shards = nullptr;
+
+  bin_data_model() { }
+
+  /*!
+   * Copies are detached from any coverpoint and keep a copy of the hit counts
+   * in their own storage. The definition is shared
+   */
+  bin_data_model(const bin_data_model& rh) : bin_base_data_model(rh),
+    bin_type(rh.bin_type), definition(rh.definition)
+  {
+    counter_span hits = rh.hits();
+    interval_hits.assign(hits.begin(), hits.end());
+  }
+
+  bin_data_model& operator=(const bin_data_model& rh)
+  {
+    if (this == &rh) return *this;
+    bin_base_data_model::operator=(rh);
+    counter_span hits = rh.hits();
+    std::vector<counter_t> hits_copy(hits.begin(), hits.end());
+    bin_type = rh.bin_type;
+    definition = rh.definition;
+    interval_hits = std::move(hits_copy);
+    hits_store = &interval_hits;
+    hits_offset = 0;
+    hits_shards = nullptr;
+    return *this;
+  }
+
+  /*!
+   * \brief Constructs an instance of a bin of another coverpoint: the
+   * definition is shared and the hit counts are at the same position in the
+   * counters of this bin's coverpoint
+   * \param proto Bin instanced, attached to its coverpoint
+   * \param owner_valid Valid flag of the coverpoint data owning this bin
+   * \param counters Counter array of the coverpoint data, as large as the
+   * counter array of the coverpoint of proto
+   * \param shards Shard counter arrays of the coverpoint data
+   */
+  bin_data_model(const bin_data_model& proto, const std::shared_ptr<bool>& owner_valid,
+                 std::vector<counter_t>& counters, const std::vector<std::vector<counter_t>>& shards)
+    : bin_base_data_model(owner_valid), bin_type(proto.bin_type), definition(proto.definition),
+      hits_store(&counters), hits_offset(proto.hits_offset), hits_shards(&shards) { }
 
   /*! Name of the bin */
-  std::string name;
+  std::string& get_name()
+  {
+    return definition->name;
+  }
+
+  /*! Name of the bin */
+  const std::string& get_name() const
+  {
+    return definition->name;
+  }
+
+  /*! Storage for the values. All are converted to intervals */
+  std::vector<interval_t<T>>& get_intervals()
+  {
+    return definition->intervals;
+  }
+
+  /*! Storage for the values. All are converted to intervals */
+  const std::vector<interval_t<T>>& get_intervals() const
+  {
+    return definition->intervals;
+  }
+
+  /*! Checks if the hit counts are stored in a coverpoint's counters */
+  bool hits_attached() const
+  {
+    return hits_store != &interval_hits;
+  }
+
+  /*! Number of hit counts of the bin */
+  size_t hits_size() const
+  {
+    return hits_attached() ? definition->intervals.size() : interval_hits.size();
+  }
+
+  /*!
+   * \brief Moves the hit counts at the end of the counters of a coverpoint
+   * \param counters Counter array of the coverpoint data
+   */
+  void attach_hits(std::vector<counter_t>& counters,
+                   const std::vector<std::vector<counter_t>>& shards)
+  {
+    std::vector<uint64_t> new_hits(definition->intervals.size(), 0);
+    counter_span old_hits = hits();
+    for (size_t i = 0; i < std::min(new_hits.size(), old_hits.size()); ++i)
+      new_hits[i] = old_hits[i];
+    hits_offset = counters.size();
+    counters.insert(counters.end(), new_hits.begin(), new_hits.end());
+    hits_store = &counters;
+    hits_shards = &shards;
+    interval_hits.clear();
+    interval_hits.shrink_to_fit();
+  }
+
+  /*!
+   * \brief Points the bin to the coverpoint counters after they were moved
+   * \param counters New location of the counter array
+   * \param shards New location of the shard counter arrays
+   */
+  void rebind_hits(std::vector<counter_t>& counters,
+                   const std::vector<std::vector<counter_t>>& shards)
+  {
+    if (hits_attached()) {
+      hits_store = &counters;
+      hits_shards = &shards;
+    }
+  }
+
+  /*! Hit counts corresponding to intervals, over all shards */
+  counter_span hits() const
+  {
+    return counter_span(*hits_store, hits_shards, hits_offset, hits_size());
+  }
+
+  /*! Counter of interval i in shard 0, for incrementing */
+  counter_t& hit_counter(size_t i)
+  {
+    return (*hits_store)[hits_offset + i];
+  }
 
   // the type of bin (default/ignore/illegal)
   //bin_t bin_type;
@@ -89,25 +238,30 @@ public:
     return bin_type;
   }
 
-  /*! Storage for hit counts corresponding to intervals */
-  //std::vector<uint64_t> interval_hits;
-  std::vector<uint64_t>& get_interval_hits()
+  /*! Hit counts corresponding to intervals */
+  counter_span get_interval_hits()
   {
-    return interval_hits;
+    return hits();
   }
 
-  /*! Name of the bin */
-  //std::string name;
-  std::string& get_name()
+  counter_span get_interval_hits(const std::vector<counter_t>& counters,
+                                 const std::vector<std::vector<counter_t>>* shards) const
   {
-    return name;
+    return counter_span(counters, shards, hits_offset, definition->intervals.size());
+  }
+
+  bin_base_data_model* create_instance(const std::shared_ptr<bool>& owner_valid,
+                                       std::vector<counter_t>& counters,
+                                       const std::vector<std::vector<counter_t>>& shards) const
+  {
+    return new bin_data_model<T>(*this, owner_valid, counters, shards);
   }
 
   /* function to introspect the bin's intervals */
   std::vector<interval_t<int>> get_intervals_to_int() const
   {
     std::vector<interval_t<int>> intervals_int;
-    for(auto inter_it : intervals)
+    for(auto inter_it : definition->intervals)
     {
       intervals_int.push_back({static_cast<int>(inter_it.first),static_cast<int>(inter_it.second)});
     }
@@ -145,7 +299,7 @@ private:
    */
   template <typename... Args>
   bin(T value, Args... args) noexcept : bin(args...) {
-    bin_data->intervals.push_back(interval(value, value));
+    bin_data->get_intervals().push_back(interval(value, value));
     bin_data->interval_hits.push_back(0);
   }
 
@@ -158,10 +312,10 @@ private:
   bin(std::vector<interval_t<T>> intervals_vec, Args... args) noexcept : bin(args...) {
     for(auto interval : intervals_vec)
     {
-      bin_data->intervals.push_back(interval);
+      bin_data->get_intervals().push_back(interval);
       bin_data->interval_hits.push_back(0);
-      if (bin_data->intervals.back().first > bin_data->intervals.back().second) {
-        std::swap(bin_data->intervals.back().first, bin_data->intervals.back().second);
+      if (bin_data->get_intervals().back().first > bin_data->get_intervals().back().second) {
+        std::swap(bin_data->get_intervals().back().first, bin_data->get_intervals().back().second);
       }
     }
   }
@@ -173,10 +327,10 @@ private:
    */
   template <typename... Args>
   bin(interval_t<T> interval, Args... args) noexcept : bin(args...) {
-    bin_data->intervals.push_back(interval);
+    bin_data->get_intervals().push_back(interval);
     bin_data->interval_hits.push_back(0);
-    if (bin_data->intervals.back().first > bin_data->intervals.back().second) {
-      std::swap(bin_data->intervals.back().first, bin_data->intervals.back().second);
+    if (bin_data->get_intervals().back().first > bin_data->get_intervals().back().second) {
+      std::swap(bin_data->get_intervals().back().first, bin_data->get_intervals().back().second);
     }
   }
 
@@ -201,15 +355,14 @@ protected:
     return bin_data->bin_type;
   }
 
-  /*! Storage for hit counts corresponding to intervals */
-  //std::vector<uint64_t> interval_hits;
-  std::vector<uint64_t>& interval_hits()
+  /*! Hit counts corresponding to intervals */
+  counter_span interval_hits()
   {
     if(valid_data.use_count() == 0) {
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
-    return bin_data->interval_hits;
+    return bin_data->get_interval_hits();
   }
 
   /*! Storage for the values. All are converted to intervals */
@@ -220,7 +373,7 @@ protected:
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
-    return bin_data->intervals;
+    return bin_data->get_intervals();
   }
 
   /*! Name of the bin */
@@ -231,7 +384,7 @@ protected:
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
-    return bin_data->name;
+    return bin_data->get_name();
   }
 
   /*!
@@ -248,9 +401,9 @@ protected:
    */
   void remove_interval_overlap()
   {
-    sort(bin_data->intervals.begin(),bin_data->intervals.end(),IntervalComp());
-    auto intrv_end = bin_data->intervals.begin();
-    for (auto intrv = std::next(intrv_end); intrv != bin_data->intervals.end(); intrv++)
+    sort(bin_data->get_intervals().begin(),bin_data->get_intervals().end(),IntervalComp());
+    auto intrv_end = bin_data->get_intervals().begin();
+    for (auto intrv = std::next(intrv_end); intrv != bin_data->get_intervals().end(); intrv++)
     {
       if(intrv_end->second >= intrv->first) {
         intrv_end->second = intrv->second;
@@ -258,13 +411,13 @@ protected:
 	          << "("  << intrv_end->first << "," << intrv_end->second << ")"
 		  << " and "
 		  << "(" << intrv->first << "," << intrv->second << ")"
-	          << " within bin \"" << this->bin_data->name << "\"\n";
+	          << " within bin \"" << this->bin_data->get_name() << "\"\n";
       }
       else {
         *(++intrv_end) = *intrv;
       }
     }
-    bin_data->intervals.erase(++intrv_end,bin_data->intervals.end());
+    bin_data->get_intervals().erase(++intrv_end,bin_data->get_intervals().end());
   }
 
 public:
@@ -277,7 +430,7 @@ public:
       throw("Error: coverage data has been deleted");
     }
     std::vector<interval_t<int>> intervals_int;
-    for(auto inter_it : bin_data->intervals)
+    for(auto inter_it : bin_data->get_intervals())
     {
       intervals_int.push_back({static_cast<int>(inter_it.first),static_cast<int>(inter_it.second)});
     }
@@ -292,7 +445,9 @@ public:
       throw("Error: coverage data has been deleted");
     }
     remove_interval_overlap();
-    cvp.insert_intervals(cvp.regular_interval_map,*this,cvp.bins.size());
+    cvp.own_bins();
+    cvp.insert_intervals(cvp.own_lookup().regular_interval_map,*this,cvp.bins.size());
+    this->bin_data->attach_hits(cvp.cvp_data->hit_counters, cvp.cvp_data->shard_counters);
     cvp.bins.push_back(*this);
     cvp.cvp_data->bins_data.push_back(this->bin_data);
   }
@@ -305,7 +460,7 @@ public:
   template<typename ...Args>
   explicit bin(const std::string &bin_name, Args... args) noexcept : bin(args...) {
     static_assert(forbid_type<std::string, Args...>::value, "Bin constructor accepts only 1 name argument!");
-    this->bin_data->name = bin_name;
+    this->bin_data->get_name() = bin_name;
     this->bin_data->bin_type = bin_t::default_;
   }
 
@@ -327,7 +482,7 @@ public:
       throw("Error: coverage data has been deleted");
     }
     uint64_t hitsum = 0;
-    for (auto hitcount : bin_data->interval_hits)
+    for (auto hitcount : bin_data->get_interval_hits())
       hitsum += hitcount;
     return hitsum;
   }
@@ -339,12 +494,9 @@ public:
    */
   uint64_t sample(const T &val, unsigned int interval_index)
   {
-    if(valid_data.use_count() == 0) {
-      std::cerr << "Error: coverage data has been deleted\n";
-      throw("Error: coverage data has been deleted");
-    }
-    if(val >= this->bin_data->intervals[interval_index].first && val <= this->bin_data->intervals[interval_index].second) {
-      this->bin_data->interval_hits[interval_index]++;
+    FC4SC_CHECK_MEMBER_SAMPLE(valid_data);
+    if(val >= this->bin_data->get_intervals()[interval_index].first && val <= this->bin_data->get_intervals()[interval_index].second) {
+      this->bin_data->hit_counter(interval_index)++;
       return 1;
     }
     else {
@@ -363,8 +515,8 @@ public:
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
-    for (size_t i = 0; i < bin_data->intervals.size(); ++i)
-      if (bin_data->intervals[i].first <= val && bin_data->intervals[i].second >= val)
+    for (size_t i = 0; i < bin_data->get_intervals().size(); ++i)
+      if (bin_data->get_intervals()[i].first <= val && bin_data->get_intervals()[i].second >= val)
         return true;
 
     return false;
@@ -376,7 +528,7 @@ public:
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
-    return bin_data->intervals.empty();
+    return bin_data->get_intervals().empty();
   }
 
   friend std::vector<interval_t<T>> reunion<T>(const bin<T>& lhs, const std::vector<interval_t<T>>& rhs);
@@ -416,17 +568,12 @@ public:
    */
   uint64_t sample(const T &val, unsigned int interval_index)
   {
-    if(this->valid_data.use_count() == 0) {
-      std::cerr << "Error: coverage data has been deleted\n";
-      throw("Error: coverage data has been deleted");
-    }
-    if(val >= this->bin_data->intervals[interval_index].first && val <= this->bin_data->intervals[interval_index].second) {
-      // construct exception to be thrown
-      std::stringstream ss; ss << val;
-      illegal_bin_sample_exception e;
-      e.update_bin_info(this->bin_data->name, ss.str());
-      this->bin_data->interval_hits[interval_index]++;
-      throw e;
+    FC4SC_CHECK_MEMBER_SAMPLE(this->valid_data);
+    if(val >= this->bin_data->get_intervals()[interval_index].first && val <= this->bin_data->get_intervals()[interval_index].second) {
+      static const std::string no_cvp_name;
+      this->bin_data->hit_counter(interval_index)++;
+      handle_illegal_hit(illegal_bin_hit(nullptr, no_cvp_name, this->bin_data->get_name(), &val, &format_sample_value<T>));
+      return 1;
     }
     else {
       return 0;
@@ -441,7 +588,9 @@ public:
       throw("Error: coverage data has been deleted");
     }
     bin<T>::remove_interval_overlap();
-    cvp.insert_intervals(cvp.illegal_interval_map,*this,cvp.illegal_bins.size());
+    cvp.own_bins();
+    cvp.insert_intervals(cvp.own_lookup().illegal_interval_map,*this,cvp.illegal_bins.size());
+    this->bin_data->attach_hits(cvp.cvp_data->hit_counters, cvp.cvp_data->shard_counters);
     cvp.illegal_bins.push_back(*this);
     cvp.cvp_data->illegal_bins_data.push_back(this->bin_data);
   }
@@ -475,7 +624,9 @@ public:
       throw("Error: coverage data has been deleted");
     }
     bin<T>::remove_interval_overlap();
-    cvp.insert_intervals(cvp.ignore_interval_map,*this,cvp.ignore_bins.size());
+    cvp.own_bins();
+    cvp.insert_intervals(cvp.own_lookup().ignore_interval_map,*this,cvp.ignore_bins.size());
+    this->bin_data->attach_hits(cvp.cvp_data->hit_counters, cvp.cvp_data->shard_counters);
     cvp.ignore_bins.push_back(*this);
     cvp.cvp_data->ignore_bins_data.push_back(this->bin_data);
   }
@@ -509,8 +660,8 @@ public:
   explicit bin_array(const std::string &name, std::vector<interval_t<T>>&& intvs) noexcept :
     count(intvs.size()), sparse(true)
   {
-    this->bin_data->name = name;
-    this->bin_data->intervals = std::move(intvs);
+    this->bin_data->get_name() = name;
+    this->bin_data->get_intervals() = std::move(intvs);
   }
 
   /*!
@@ -520,8 +671,8 @@ public:
   explicit bin_array(const std::string &name, std::vector<interval_t<T>>& intvs) noexcept :
     count(intvs.size()), sparse(true)
   {
-    this->bin_data->name = name;
-    this->bin_data->intervals = intvs;
+    this->bin_data->get_name() = name;
+    this->bin_data->get_intervals() = intvs;
   }
 
   /*!
@@ -531,12 +682,12 @@ public:
   explicit bin_array(const std::string &name, const std::vector<T>& intvs) noexcept :
     count(intvs.size()), sparse(true)
   {
-    this->bin_data->name = name;
-    this->bin_data->intervals.clear();
-    this->bin_data->intervals.reserve(this->count);
+    this->bin_data->get_name() = name;
+    this->bin_data->get_intervals().clear();
+    this->bin_data->get_intervals().reserve(this->count);
     // transform each value in the input vector to an interval
     std::transform(intvs.begin(), intvs.end(),
-                   std::back_inserter(this->bin_data->intervals),
+                   std::back_inserter(this->bin_data->get_intervals()),
                    [](const T& v) { return fc4sc::interval(v,v); });
   }
 
@@ -550,18 +701,18 @@ public:
       // create a new bin for each value/interval and add it to the coverpoint
       std::stringstream ss;
 
-      for (size_t i = 0; i < this->bin_data->intervals.size(); ++i) {
-        ss << this->bin_data->name << "[" << i << "]";
-        //cvp.bins.push_back(bin<T>(ss.str(), this->bin_data->intervals[i]));
-	bin<T>(ss.str(), this->bin_data->intervals[i]).add_to_cvp(cvp);
+      for (size_t i = 0; i < this->bin_data->get_intervals().size(); ++i) {
+        ss << this->bin_data->get_name() << "[" << i << "]";
+        //cvp.bins.push_back(bin<T>(ss.str(), this->bin_data->get_intervals()[i]));
+	bin<T>(ss.str(), this->bin_data->get_intervals()[i]).add_to_cvp(cvp);
         ss.str(std::string()); // clear the stringstream
       }
     }
     else {
       // bin array was defined by using an interval which needs to be split into
-      // multiple pieces. The interval is found in the this->bin_data->intervals[0]
+      // multiple pieces. The interval is found in the this->bin_data->get_intervals()[0]
 
-      uint64_t interval_length = (this->bin_data->intervals[0].second - this->bin_data->intervals[0].first) + 1;
+      uint64_t interval_length = (this->bin_data->get_intervals()[0].second - this->bin_data->get_intervals()[0].first) + 1;
 
       if (this->count > interval_length) {
         // This bin array interval cannot be split into pieces. Add a single
@@ -573,12 +724,12 @@ public:
       else {
         std::stringstream ss;
         // This bin array interval must be split into pieces.
-        T start = this->bin_data->intervals[0].first;
-        T stop = this->bin_data->intervals[0].second;
+        T start = this->bin_data->get_intervals()[0].first;
+        T stop = this->bin_data->get_intervals()[0].second;
         T interval_len = (interval_length + 1) / this->count;
 
         for (size_t i = 0; i < this->count; ++i) {
-          ss << this->bin_data->name << "[" << i << "]";
+          ss << this->bin_data->get_name() << "[" << i << "]";
           // the last interval, will contain all the extra elements
           T end = (i == (this->count - 1)) ? stop : start + (interval_len - 1);
           //cvp.bins.push_back(bin<T>(ss.str(), interval(start, end)));
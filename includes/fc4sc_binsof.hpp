@@ -1,6 +1,7 @@
 /******************************************************************************
 
    Copyright 2003-2018 AMIQ Consulting s.r.l.
+   Copyright 2020 NVIDIA Corporation
 
    Licensed under the Apache License, Version 2.0 (the "License");
    you may not use this file except in compliance with the License.
@@ -22,9 +23,24 @@
                Date: 2018-Feb-20
 ******************************************************************************/
 
+/*!
+ \file fc4sc_binsof.hpp
+ \brief Cross bin selection
+
+   binsof expressions select combinations of coverpoint bins, used to declare
+ the bins, ignore bins and illegal bins of a cross. The expressions are
+ compiled to one bin mask per crossed coverpoint, so checking a sampled
+ combination against a selection only tests a few bits.
+ */
+
 #ifndef FC4SC_BINSONF_HPP
 #define FC4SC_BINSONF_HPP
 
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "fc4sc_base.hpp"
 #include "fc4sc_intervals.hpp"
 
 namespace fc4sc {
@@ -35,39 +51,210 @@ class coverpoint;
 template <typename T>
 class bin;
 
+template <typename T>
+class bin_data_model;
+
+/*! Bit set over the regular bins of a coverpoint, 64 bins per word */
+typedef std::vector<uint64_t> bin_mask;
+
+/*!
+ * \class binsof fc4sc_binsof.hpp
+ * \brief Selects bins of one coverpoint
+ * \tparam T Type of the coverpoint values
+ *
+ * Equivalent of the SystemVerilog binsof construct:
+ *  - binsof<T>(&cvp) selects all the bins of cvp
+ *  - binsof<T>(&cvp, "name") selects the bin called name
+ *  - .intersect(...) keeps the bins with a value in the given intervals
+ *  - !binsof<T>(...) selects the bins not selected by the operand
+ * Selections of several coverpoints are combined with && and ||.
+ */
 template <typename T>
 class binsof {
-  // TODO: implementation needed
 public:
 
+  /*! Data of the coverpoint whose bins are selected */
+  const cvp_base_data_model* cvp_data = nullptr;
+
+  /*! Name of the selected bin, all bins are selected if empty */
+  std::string bin_name;
+
+  /*! Only bins with a value in these intervals are selected, unless empty */
   std::vector<interval_t<T>> allowed_bins;
 
+  /*! Selects the bins not selected otherwise */
+  bool negated = false;
+
   binsof() {}
 
-  binsof(coverpoint<T> cvp) {
-    (void)cvp; // suppress warning
-  };
+  explicit binsof(coverpoint<T>* cvp) : cvp_data(cvp->get_data()) {}
 
-  binsof(bin<T> cvp) {
-    (void)cvp; // suppress warning
-  };
+  binsof(coverpoint<T>* cvp, const std::string& bin_name) :
+    cvp_data(cvp->get_data()), bin_name(bin_name) {}
 
-  binsof<T>& operator||(const binsof<T> &rhs) {
-    (void)rhs; // suppress warning
-    return *this;
-  };
+  /*! Keeps the selected bins with a value in one of the intervals */
+  binsof<T> intersect(const std::vector<interval_t<T>>& intervals) const
+  {
+    binsof<T> result = *this;
+    result.allowed_bins.insert(result.allowed_bins.end(), intervals.begin(), intervals.end());
+    return result;
+  }
+
+  /*! Keeps the selected bins with a value in the interval */
+  binsof<T> intersect(interval_t<T> values) const
+  {
+    return intersect(std::vector<interval_t<T>>{ values });
+  }
+
+  /*! Keeps the selected bins containing the value */
+  binsof<T> intersect(T value) const
+  {
+    return intersect(interval(value, value));
+  }
+
+  /*! Selects the bins of the coverpoint not selected by this expression */
+  binsof<T> operator!() const
+  {
+    binsof<T> result = *this;
+    result.negated = !negated;
+    return result;
+  }
+
+  /*!
+   * \brief Compiles the selection for the current bins of a coverpoint
+   * \param cvp Data of the coverpoint, holding bins of type T
+   * \param mask Receives the bit of each regular bin, set if selected
+   */
+  void select(const coverpoint_base_data_model* cvp, bin_mask& mask) const
+  {
+    const std::vector<bin_base_data_model*>& bins = cvp->declared_bins();
+    const size_t n = bins.size();
+    mask.assign((n + 63) / 64, 0);
+    for (size_t i = 0; i < n; ++i) {
+      auto data = static_cast<const bin_data_model<T>*>(bins[i]);
+      bool selected = bin_name.empty() || data->get_name() == bin_name;
+      if (selected && !allowed_bins.empty()) {
+        selected = false;
+        for (auto& bin_interval : data->get_intervals())
+          for (auto& allowed : allowed_bins)
+            selected |= (bin_interval.first <= allowed.second && allowed.first <= bin_interval.second);
+      }
+      if (selected != negated) mask[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+};
+
+/*!
+ * \class cross_select fc4sc_binsof.hpp
+ * \brief Selection of cross bins, built from binsof expressions
+ *
+ * Stored as a disjunction of terms, each term being a conjunction of
+ * binsof conditions. A combination of bins is selected if, for some term,
+ * the bin of every constrained coverpoint is selected by its conditions.
+ */
+class cross_select {
+public:
 
-  binsof<T>& operator&&(const binsof<T> &rhs) {
-    (void)rhs; // suppress warning
-    return *this;
+  /*! A binsof condition on one coverpoint */
+  struct condition {
+    /*! Data of the constrained coverpoint */
+    const cvp_base_data_model* cvp;
+    /*! Position of the coverpoint in the cross, resolved by the cross */
+    size_t position;
+    /*! Compiles the condition to a bin mask */
+    std::function<void(const coverpoint_base_data_model*, bin_mask&)> select;
   };
 
-  binsof<T>& intersect() {
-    return *this;
+  /*! Conjunction of conditions */
+  typedef std::vector<condition> term;
+
+  /*! Disjunction of terms */
+  std::vector<term> terms;
+
+  cross_select() {}
+
+  template <typename T>
+  cross_select(const binsof<T>& selection)
+  {
+    terms.push_back(term{ condition{ selection.cvp_data, 0,
+      [selection](const coverpoint_base_data_model* cvp, bin_mask& mask) {
+        selection.select(cvp, mask);
+      } } });
+  }
+
+};
+
+/*! Selects the combinations selected by either operand */
+inline cross_select operator||(const cross_select& lhs, const cross_select& rhs)
+{
+  cross_select result = lhs;
+  result.terms.insert(result.terms.end(), rhs.terms.begin(), rhs.terms.end());
+  return result;
+}
+
+/*! Selects the combinations selected by both operands */
+inline cross_select operator&&(const cross_select& lhs, const cross_select& rhs)
+{
+  cross_select result;
+  for (auto& lhs_term : lhs.terms)
+    for (auto& rhs_term : rhs.terms) {
+      cross_select::term both = lhs_term;
+      both.insert(both.end(), rhs_term.begin(), rhs_term.end());
+      result.terms.push_back(both);
+    }
+  return result;
+}
+
+/*!
+ * \class cross_bin fc4sc_binsof.hpp
+ * \brief User-defined bin of a cross, counting every hit of the combinations
+ * it selects. Passed to the cross constructor after the coverpoints
+ */
+class cross_bin {
+public:
+
+  /*! Name of the bin */
+  std::string name;
+
+  /*! Type of the bin (default/ignore/illegal) */
+  bin_t type = default_;
+
+  /*! Selected combinations */
+  cross_select select;
+
+  cross_bin(const std::string& name, const cross_select& select) :
+    name(name), select(select) {}
+
+};
+
+/*!
+ * \class ignore_cross_bin fc4sc_binsof.hpp
+ * \brief Combinations excluded from a cross. Samples hitting them are
+ * counted as misses of the cross
+ */
+class ignore_cross_bin : public cross_bin {
+public:
+  ignore_cross_bin(const std::string& name, const cross_select& select) :
+    cross_bin(name, select)
+  {
+    type = ignore_;
+  }
+};
+
+/*!
+ * \class illegal_cross_bin fc4sc_binsof.hpp
+ * \brief Combinations that must not be sampled. Hitting one throws an
+ * illegal_bin_sample_exception, like an illegal coverpoint bin
+ */
+class illegal_cross_bin : public cross_bin {
+public:
+  illegal_cross_bin(const std::string& name, const cross_select& select) :
+    cross_bin(name, select)
+  {
+    type = illegal_;
   }
 };
 
 }	// namespace fc4sc
 
 #endif
-
@@ -39,6 +39,9 @@
 #include <unordered_map>
 #include <typeinfo>
 #include <tuple>
+#include <mutex>
+#include <exception>
+#include <memory>
 
 namespace fc4sc
 {
@@ -73,7 +76,10 @@ protected:
    * This function registers a coverpoint instance inside this covergroup.
    * It receives as arguments a pointer to the coverpoint to be registered,
    * the coverpoint name, the sample expression lambda function and string,
-   * and finally, the sample condition lambda function and string.
+   * the sample condition lambda function and string, and optionally a thunk
+   * sampling both the condition and the expression without type erasure,
+   * with the covergroup pointer to call it with, and the schema the bins are
+   * shared through.
    * Finally, it returns a coverpoint constructed with the given arguments.
    * The purpose of this function is to be used for coverpoint instantiation
    * via the COVERPOINT macro and should not be explicitly used!
@@ -81,7 +87,9 @@ protected:
   template<typename T>
   coverpoint <T> register_cvp(coverpoint <T>* cvp, std::string&& cvp_name,
     std::function<T()>&& sample_expr, std::string&& sample_expr_str,
-    std::function<bool()>&& sample_cond, std::string&& sample_cond_str) {
+    std::function<bool()>&& sample_cond, std::string&& sample_cond_str,
+    bool (*inline_sample)(void*, T&) = nullptr, void* inline_sample_ctx = nullptr,
+    typename coverpoint<T>::bin_schema* schema = nullptr) {
 
     // NOTE: VERY important! Do not attempt to dereference the cvp pointer in
     // any way because it points to uninitialized memory!
@@ -90,13 +98,60 @@ protected:
     cvp_structure.has_sample_expression = true;
     cvp_structure.sample_expression = sample_expr;
     cvp_structure.sample_condition = sample_cond;
+    cvp_structure.inline_sample = inline_sample;
+    cvp_structure.inline_sample_ctx = inline_sample_ctx;
     cvp_structure.cvp_data->sample_expression_str = sample_expr_str;
     cvp_structure.cvp_data->sample_condition_str = sample_cond_str;
     cvp_structure.name() = cvp_name;
+    if (schema && shared_bins()) {
+      cvp_structure.schema = schema;
+      if (schema->proto.load()) cvp_structure.share_schema();
+    }
     cvg_data->add_cvp_data(cvp_structure.cvp_data);
     return cvp_structure;
   }
 
+  /*!
+   * \brief Checks if the coverpoints declared with the COVERPOINT macro share
+   * their bins with the other instances of the covergroup type. The bins are
+   * then built by the first instance, and the bin declarations are not
+   * evaluated by the later ones. Covergroups whose bins differ between
+   * instances, e.g. depending on constructor arguments, return false
+   */
+  virtual bool shared_bins() const
+  {
+    return true;
+  }
+
+  /*!
+   * Schema of the bins of the coverpoint sampled by Fn, declared with the
+   * COVERPOINT macro in covergroup type Cvg
+   */
+  template<typename Cvg, typename T, bool (Cvg::*Fn)(T&)>
+  static typename coverpoint<T>::bin_schema& cvp_schema() {
+    static typename coverpoint<T>::bin_schema schema;
+    return schema;
+  }
+
+  /*!
+   * Checks if a coverpoint declared with the COVERPOINT macro gets its bins
+   * from schema, skipping its bin declarations
+   */
+  template<typename T>
+  bool schema_built(typename coverpoint<T>::bin_schema& schema) const {
+    return shared_bins() && schema.proto.load();
+  }
+
+  /*
+   * Calls the sampling member function Fn, declared by the COVERPOINT macro,
+   * on the covergroup cvg. Each instantiation is a plain function with the
+   * sample expression and condition inlined in it.
+   */
+  template<typename Cvg, typename T, bool (Cvg::*Fn)(T&)>
+  static bool sample_thunk(void* cvg, T& val) {
+    return (static_cast<Cvg*>(cvg)->*Fn)(val);
+  }
+
   std::unordered_map<cvp_base *, cvp_metadata_t> cvp_strings;
 
   /*!
@@ -173,35 +228,516 @@ protected:
   covergroup &operator=(covergroup &&other) = delete;
 
   /*! Destructor */
-  virtual ~covergroup() { }
+  virtual ~covergroup() {
+    // The coverpoints and crosses are gone, they stopped the worker already
+    if (!async_worker) return;
+    async_worker->stop();
+    if (valid_data.use_count() != 0)
+      cvg_data->async_worker = nullptr;
+  }
 
 public:
 
   virtual void sample() {
+    FC4SC_CHECK_CVG_SAMPLE(valid_data);
+    if(this->is_enabled()) {
+      sample_cvps();
+    }
+    else {
+      std::cerr << "Warning: attempted to sample a disabled covergroup\n";
+    }
+  }
+
+  /*!
+   * \brief Samples the covergroup once for every transaction of an array
+   * \param txns Pointer to the first transaction
+   * \param n Number of transactions
+   * \param apply Callable receiving one transaction, which loads it into the
+   * sample points or the variables read by the sample expressions
+   *
+   * Counts the same as calling apply() followed by sample() for each
+   * transaction. The transactions are taken in blocks: the values sampled
+   * for every transaction of a block are captured first, then each
+   * coverpoint looks up all its values of the block at once, then the
+   * block is counted one transaction at a time so that crosses see the bins
+   * hit by that transaction. apply() may therefore run for a whole block
+   * before an illegal bin hit stops the sample. A covergroup sampling
+   * asynchronously, or holding objects that cannot capture their values,
+   * samples the transactions one by one.
+   */
+  template <typename Txn, typename Apply>
+  void sample_batch(const Txn* txns, size_t n, Apply apply) {
+    FC4SC_CHECK_CVG_SAMPLE(valid_data);
+    if(!this->is_enabled()) {
+      std::cerr << "Warning: attempted to sample a disabled covergroup\n";
+      return;
+    }
+    if (!can_batch_lookups()) {
+      for (size_t i = 0; i < n; ++i) {
+        apply(txns[i]);
+        sample_cvps();
+      }
+      return;
+    }
+
+    if (planned_cvps.load(std::memory_order_acquire) != this->cvps.size())
+      plan_sampling();
+    const size_t block = 64;
+    const size_t slots = this->cvps.size();
+    const size_t record_size = layout_captures();
+    std::vector<unsigned char> records(record_size * block);
+    std::vector<size_t> found(slots * block);
+
+    for (size_t first = 0; first < n; first += block) {
+      size_t len = std::min(block, n - first);
+      // Objects reaching their goal in the last block are no longer captured
+      capture_planned();
+      for (size_t i = 0; i < len; ++i) {
+        apply(txns[first + i]);
+        for (auto& capture : async_captures)
+          capture.first->capture_sample(records.data() + i * record_size + capture.second);
+      }
+      for (auto& capture : async_captures)
+        capture.first->lookup_captured(records.data() + capture.second, record_size, len,
+                                       found.data() + capture.first->cvg_slot, slots);
+      for (size_t i = 0; i < len; ++i) {
+        if (planned_cvps.load(std::memory_order_acquire) != slots)
+          plan_sampling();
+        count_sample(records.data() + i * record_size, found.data() + i * slots);
+      }
+    }
+  }
+
+  /*!
+   * \brief Makes the covergroup count samples in several shards, so that
+   * several threads can sample it concurrently without locking
+   * \param shards Number of shards, 1 disables sharding
+   *
+   * Each sampling thread selects its shard with fc4sc::set_thread_shard(),
+   * and no two threads may sample into the same shard at the same time.
+   * Hit counts, misses and the bins hit by the last sample are kept per shard
+   * and combined when coverage is queried or saved. The values read by the
+   * sample expressions must themselves be private to each thread, e.g.
+   * thread_local variables. Must not be called while sampling, and no bins
+   * may be added while several threads sample.
+   */
+  void set_shards(size_t shards) {
     if(valid_data.use_count() == 0) {
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
-    if(this->is_enabled()) {
-      for (auto& cvp : this->cvps) {
-        try {
-          cvp->sample();
+    for (auto& cvp : this->cvps)
+      cvp->set_shards(shards);
+    // no thread samples meanwhile
+    std::lock_guard<std::mutex> lock(plan_mutex);
+    reclaim_plans();
+  }
+
+  /*!
+   * \brief Makes sample() only queue the sampled values, counted by a
+   * worker thread
+   * \param capacity Number of samples queued before sample() waits for the
+   * worker. 0 counts the queued samples and returns to synchronous sampling
+   * \returns False if a coverpoint or cross cannot be sampled this way, in
+   * which case sampling stays synchronous
+   *
+   * sample() evaluates the sample conditions and expressions on the calling
+   * thread and copies the results to a lock-free queue, so a single thread
+   * may sample the covergroup. The queued samples are counted before the
+   * covergroup coverage is computed, saved or visited; before querying its
+   * coverpoints and crosses directly, call drain_samples(). The bins hit by
+   * the last sample are not known to the sampling thread. An illegal bin hit
+   * counted by the worker, or an exception thrown by the illegal bin
+   * callback, is rethrown by the next sample() or drain_samples().
+   */
+  bool set_async_sampling(size_t capacity) {
+    if(valid_data.use_count() == 0) {
+      std::cerr << "Error: coverage data has been deleted\n";
+      throw("Error: coverage data has been deleted");
+    }
+    stop_async_worker();
+    async_capacity = capacity;
+    if (capacity == 0) return true;
+    for (auto& cvp : this->cvps) {
+      if (!cvp->can_capture()) {
+        std::cerr << "Warning: " << cvp->name() << " cannot be sampled asynchronously, "
+                  << this->name() << " samples synchronously\n";
+        return false;
+      }
+    }
+    if (planned_cvps.load(std::memory_order_acquire) != this->cvps.size())
+      plan_sampling();
+
+    size_t record_size = layout_captures();
+    capture_planned();
+    async_worker.reset(new sample_worker(record_size, capacity,
+      [this](const unsigned char* record) { this->count_sample(record, nullptr, true); }));
+    for (auto& cvp : this->cvps)
+      cvp->async_worker = async_worker.get();
+    cvg_data->async_worker = async_worker.get();
+    return true;
+  }
+
+  /*!
+   * \brief Waits until the samples queued by asynchronous sampling are
+   * counted, then rethrows an illegal bin hit by one of them
+   */
+  void drain_samples() {
+    if (!async_worker) return;
+    async_worker->drain();
+    rethrow_async_error();
+  }
+
+private:
+
+  /*! Objects of the same type, sampled by one call to their group function */
+  struct sample_step {
+    cvp_base::sample_group_fn sample_group;
+    std::vector<cvp_base*> cvps;
+    /*! The step runs once every period samples */
+    uint32_t period;
+    /*! Samples seen by a step with a period */
+    mutable counter_t calls;
+  };
+
+  /*!
+   * Sampling plan: the coverpoints and crosses in declaration order, each
+   * run of consecutive objects of the same type sampled as one step. Objects
+   * stopped at their goal are left out
+   */
+  typedef std::vector<sample_step> sample_plan_t;
+
+  /*! Plan in use, owned by current_plan */
+  std::atomic<const sample_plan_t*> sample_plan{nullptr};
+
+  /*! Owner of the plan in use */
+  std::unique_ptr<sample_plan_t> current_plan;
+
+  /*!
+   * Plans replaced while other threads may still run them, freed by
+   * reclaim_plans(). Only sharded sampling and FC4SC_ATOMIC_COUNTERS keep
+   * them, at most one per object reaching its goal
+   */
+  std::vector<std::unique_ptr<sample_plan_t>> retired_plans;
+
+  /*!
+   * Number of coverpoints and crosses in the sampling plan, reset by the
+   * objects reaching their goal to have the plan built again
+   */
+  std::atomic<size_t> planned_cvps{0};
+
+  /*! Serializes plan_sampling() between threads starting to sample */
+  std::mutex plan_mutex;
+
+  /*! Number of coverpoints and crosses set up by prepare_sampling() */
+  size_t prepared_cvps = 0;
+
+  /*!
+   * \brief Appends obj to the last step if it samples the same type with the
+   * same period, else to a new step, keeping the declaration order
+   */
+  static void add_to_plan(sample_plan_t& plan, cvp_base* obj, uint32_t period)
+  {
+    cvp_base::sample_group_fn fn = obj->sample_group();
+    if (!plan.empty() && plan.back().sample_group == fn && plan.back().period == period) {
+      plan.back().cvps.push_back(obj);
+      return;
+    }
+    plan.push_back(sample_step{fn, std::vector<cvp_base*>(1, obj), period, 0});
+  }
+
+  /*!
+   * Checks if threads other than the one planning may be running a sample:
+   * sharded sampling, or any sampling with FC4SC_ATOMIC_COUNTERS defined
+   */
+  bool sampled_concurrently() const
+  {
+#ifdef FC4SC_ATOMIC_COUNTERS
+    return true;
+#else
+    for (auto& cvp : this->cvps)
+      if (!cvp->shard_states.empty()) return true;
+    return false;
+#endif
+  }
+
+  /*!
+   * \brief Frees the replaced plans. Called with plan_mutex held, where no
+   * other thread can be running one of them
+   */
+  void reclaim_plans()
+  {
+    retired_plans.clear();
+  }
+
+  /*!
+   * \brief Period obj is sampled with, 0 if it is not sampled. Reports the
+   * objects whose sampling gets cut back
+   */
+  uint32_t sample_period(cvp_base* obj) {
+    cvp_base_data_model* data = obj->get_data();
+    if (!data->goal_reached.load(std::memory_order_acquire)) return 1;
+    if (!data->sampling_cut) {
+      data->sampling_cut = true;
+      std::cerr << "Warning: " << obj->name() << " in " << this->name() << " reached its goal, ";
+      if (data->at_goal_sample_period == 0)
+        std::cerr << "sampling stopped";
+      else
+        std::cerr << "sampled once every " << data->at_goal_sample_period << " samples";
+      std::cerr << ": its hit counts are not totals\n";
+    }
+    return data->at_goal_sample_period;
+  }
+
+  /*!
+   * \brief Gives each coverpoint and cross its slot in the per-call sample
+   * results, copies its options and builds its sampling index. Only runs
+   * once objects were added, which no other thread may sample meanwhile
+   */
+  void prepare_sampling() {
+    for (size_t i = 0; i < this->cvps.size(); ++i) {
+      cvp_base* obj = this->cvps[i];
+      obj->cvg_slot = i;
+      obj->cvg_name = &cvg_data->name;
+      obj->prepare_sample();
+      cvp_base_data_model* data = obj->get_data();
+      if (cvg_data->option.stop_at_goal) {
+        data->stop_at_goal = true;
+        data->at_goal_sample_period = cvg_data->option.at_goal_sample_period;
+      }
+      data->sampling_planned = &planned_cvps;
+    }
+    prepared_cvps = this->cvps.size();
+  }
+
+  /*!
+   * \brief Builds the sampling plan and publishes it, once for all threads.
+   * The plan built again for the objects reaching their goal only leaves them
+   * out: other threads may still be sampling them. The replaced plan is freed
+   * unless another thread may still run it
+   */
+  void plan_sampling() {
+    std::lock_guard<std::mutex> lock(plan_mutex);
+    if (planned_cvps.load(std::memory_order_relaxed) == this->cvps.size()) return;
+    // Objects reaching their goal while the plan is built reset it to 0
+    const size_t planning = size_t(-1);
+    planned_cvps.store(planning, std::memory_order_relaxed);
+    if (prepared_cvps != this->cvps.size()) prepare_sampling();
+
+    // crosses still sampled read the bins hit by their coverpoints, which
+    // are then sampled on every sample
+    const size_t n = this->cvps.size();
+    std::vector<uint32_t> periods(n, 0);
+    std::vector<bool> is_cross(n, false);
+    std::vector<cvp_base*> crossed;
+    for (size_t i = 0; i < n; ++i) {
+      cross_base* crs = dynamic_cast<cross_base*>(this->cvps[i]);
+      if (!crs) continue;
+      is_cross[i] = true;
+      periods[i] = sample_period(crs);
+      if (periods[i] == 0) continue;
+      const std::vector<cvp_base*>& cvps = crs->get_cross_coverpoints();
+      crossed.insert(crossed.end(), cvps.begin(), cvps.end());
+    }
+
+    std::unique_ptr<sample_plan_t> plan(new sample_plan_t);
+    for (size_t i = 0; i < n; ++i) {
+      cvp_base* obj = this->cvps[i];
+      if (!is_cross[i]) {
+        bool is_crossed = std::find(crossed.begin(), crossed.end(), obj) != crossed.end();
+        periods[i] = is_crossed ? 1 : sample_period(obj);
+      }
+      if (periods[i] != 0) add_to_plan(*plan, obj, periods[i]);
+    }
+
+    // The worker counting queued samples runs the plan in use until drained
+    if (async_worker) async_worker->drain();
+    sample_plan.store(plan.get(), std::memory_order_release);
+    if (current_plan) retired_plans.push_back(std::move(current_plan));
+    current_plan = std::move(plan);
+    if (!sampled_concurrently()) reclaim_plans();
+    size_t expected = planning;
+    planned_cvps.compare_exchange_strong(expected, this->cvps.size(), std::memory_order_release);
+  }
+
+  /*! Worker thread counting the samples while sampling asynchronously */
+  std::unique_ptr<sample_worker> async_worker;
+
+  /*! Queue capacity asked for by set_async_sampling() */
+  size_t async_capacity = 0;
+
+  /*! Coverpoints reading a value and the offset of the value in a record */
+  std::vector<std::pair<cvp_base*, size_t>> async_captures;
+
+  /*! Offset of the value captured by each object in a record, by slot */
+  std::vector<size_t> capture_offsets;
+
+  /*! First illegal bin exception counted by the worker, not yet rethrown */
+  std::exception_ptr async_error;
+
+  /*! Set by the worker once async_error holds an exception */
+  std::atomic<bool> async_failed{false};
+
+  /*!
+   * \brief Lays out the values captured by the coverpoints in a record
+   * \returns Size of a record in bytes
+   */
+  size_t layout_captures() {
+    size_t record_size = 0;
+    async_captures.clear();
+    capture_offsets.assign(this->cvps.size(), 0);
+    for (size_t i = 0; i < this->cvps.size(); ++i) {
+      capture_offsets[i] = record_size;
+      if (this->cvps[i]->capture_size() > 0)
+        async_captures.push_back(std::make_pair(this->cvps[i], record_size));
+      record_size += this->cvps[i]->capture_size();
+    }
+    return record_size;
+  }
+
+  /*! Captures only the values of the objects in the sampling plan */
+  void capture_planned() {
+    async_captures.clear();
+    for (auto& step : *sample_plan.load(std::memory_order_acquire))
+      for (auto obj : step.cvps)
+        if (obj->capture_size() > 0)
+          async_captures.push_back(std::make_pair(obj, capture_offsets[obj->cvg_slot]));
+  }
+
+  /*! Checks if sample_batch() can capture the values and batch the lookups */
+  bool can_batch_lookups() const {
+    if (async_worker) return false;
+    for (auto& cvp : this->cvps)
+      if (!cvp->can_capture()) return false;
+    return true;
+  }
+
+  /*! Ends the worker thread once the queued samples are counted */
+  void stop_async_worker() {
+    if (!async_worker) return;
+    async_worker->stop();
+    for (auto& cvp : this->cvps)
+      cvp->async_worker = nullptr;
+    if (valid_data.use_count() != 0)
+      cvg_data->async_worker = nullptr;
+    async_worker.reset();
+  }
+
+  /*! Rethrows on the sampling thread an exception thrown on the worker */
+  void rethrow_async_error() {
+    if (!async_failed.load(std::memory_order_acquire)) return;
+    std::exception_ptr e = async_error;
+    async_error = nullptr;
+    async_failed.store(false, std::memory_order_release);
+    std::cerr << "Stopping simulation\n";
+    std::rethrow_exception(e);
+  }
+
+  /*! Samples all coverpoints and crosses, or queues the sample */
+  void sample_cvps() {
+    if (planned_cvps.load(std::memory_order_acquire) != this->cvps.size()) {
+      // Coverpoints added since the sample queue was laid out: lay it out again
+      if (async_worker && capture_offsets.size() != this->cvps.size())
+        set_async_sampling(async_capacity);
+      else {
+        plan_sampling();
+        // Objects that reached their goal are no longer captured
+        if (async_worker) capture_planned();
+      }
+    }
+    if (async_worker) {
+      rethrow_async_error();
+      unsigned char* record = async_worker->back();
+      for (auto& capture : async_captures)
+        capture.first->capture_sample(record + capture.second);
+      async_worker->push();
+      return;
+    }
+    count_sample(nullptr);
+  }
+
+  /*!
+   * \brief Counts one sample through the sampling plan
+   * \param record Values captured by capture_sample(), nullptr to read the
+   * values on the calling thread
+   * \param found Lookups of the captured values by lookup_captured(), by
+   * slot. nullptr to look the values up while counting
+   * \param on_worker Set when counting on the worker thread, which cannot
+   * stop the simulation
+   */
+  void count_sample(const unsigned char* record, const size_t* found = nullptr, bool on_worker = false) {
+#ifdef FC4SC_ATOMIC_COUNTERS
+    // The results of this sample, read by the crosses, live on the stack of
+    // the calling thread so that concurrent samples do not share them
+    const size_t results_inline = 64;
+    cvp_sample_result inline_results[results_inline];
+    std::vector<cvp_sample_result> heap_results;
+    cvp_sample_result* results = inline_results;
+    if (this->cvps.size() > results_inline) {
+      heap_results.resize(this->cvps.size());
+      results = heap_results.data();
+    }
+    for (size_t i = 0; i < this->cvps.size(); ++i) {
+      results[i].bins_hit.clear();
+      results[i].last_sample_success = false;
+    }
+    call_results_scope results_scope(results);
+#endif
+    const sample_plan_t& plan = *sample_plan.load(std::memory_order_acquire);
+    size_t step = 0;
+    size_t next = 0;
+    while (step < plan.size()) {
+      try {
+        for (; step < plan.size(); ++step, next = 0) {
+          const sample_step& s = plan[step];
+          if (s.period != 1 && next == 0 && count_hit(s.calls) % s.period != 0) continue;
+          if (found) {
+            for (; next < s.cvps.size(); ++next) {
+              size_t slot = s.cvps[next]->cvg_slot;
+              s.cvps[next]->sample_found_captured(record + capture_offsets[slot], found[slot]);
+            }
+          }
+          else if (record) {
+            for (; next < s.cvps.size(); ++next)
+              s.cvps[next]->sample_captured(record + capture_offsets[s.cvps[next]->cvg_slot]);
+          }
+          else {
+            s.sample_group(s.cvps.data(), s.cvps.size(), next);
+          }
         }
-        catch(illegal_bin_sample_exception &e) {
-          e.update_cvg_info(this->name());
-          std::cerr << e.what() << std::endl;
+      }
+      catch(illegal_bin_sample_exception &e) {
+        e.update_cvg_info(this->name());
+        std::cerr << e.what() << std::endl;
 #ifndef FC4SC_NO_THROW // By default the simulation will stop
-          std::cerr << "Stopping simulation\n";
-	  throw(e);
+        if (on_worker) {
+          // The worker cannot stop the simulation, the next sample() does
+          if (!async_failed.load(std::memory_order_acquire)) {
+            async_error = std::make_exception_ptr(e);
+            async_failed.store(true, std::memory_order_release);
+          }
+          return;
+        }
+        std::cerr << "Stopping simulation\n";
+        throw(e);
 #endif
+        // Resume after the object that threw
+        ++next;
+      }
+      catch(...) {
+        // Thrown by an illegal bin callback: the next sample() rethrows it
+        if (!on_worker) throw;
+        if (!async_failed.load(std::memory_order_acquire)) {
+          async_error = std::current_exception();
+          async_failed.store(true, std::memory_order_release);
         }
+        return;
       }
     }
-    else {
-      std::cerr << "Warning: attempted to sample a disabled covergroup\n";
-    }
   }
 
+public:
+
   virtual void disable_cvg() {
     if(valid_data.use_count() == 0) {
       std::cerr << "Error: coverage data has been deleted\n";
@@ -220,6 +756,7 @@ public:
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
+    if (async_worker) async_worker->drain();
     if(this->is_enabled()) {
       double res = 0;
       double weights = 0;
@@ -231,10 +768,10 @@ public:
       }
 
       if (weights == 0 || cvps.size() == 0 || res == 0)
-        return (this->option().weight == 0) ? 100 : 0;
+        return (cvg_data->option.weight == 0) ? 100 : 0;
 
       double real = res / weights;
-      return (real >= this->option().goal) ? 100 : real;
+      return (real >= cvg_data->option.goal) ? 100 : real;
     }
     else {
       std::cerr << "Warning: called get_inst_coverage on disabled covergroup\n";
@@ -248,17 +785,18 @@ public:
    * \param total Total number of bins in this covergroup
    * \returns Coverage percentage of this instance
    */
-  double get_inst_coverage(int &bins_covered, int &total) const 
+  double get_inst_coverage(uint64_t &bins_covered, uint64_t &total) const 
   {
     if(valid_data.use_count() == 0) {
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
+    if (async_worker) async_worker->drain();
     if(this->is_enabled()) {
       double res = 0;
       double weights = 0;
-      int bins_aux = 0;
-      int total_aux = 0;
+      uint64_t bins_aux = 0;
+      uint64_t total_aux = 0;
 
       bins_covered = 0;
       total = 0;
@@ -273,11 +811,11 @@ public:
 
       if (weights == 0 || cvps.size() == 0 || res == 0)
       {
-        return (this->option().weight == 0) ? 100 : 0;
+        return (cvg_data->option.weight == 0) ? 100 : 0;
       }
 
       double real = res / weights;
-      return (real >= this->option().goal) ? 100 : real;
+      return (real >= cvg_data->option.goal) ? 100 : real;
     }
     else {
       std::cerr << "Warning: called get_inst_coverage on disabled covergroup\n";
@@ -285,6 +823,9 @@ public:
     }
   }
 
+  /*! int version of get_inst_coverage(uint64_t&, uint64_t&) */
+  using api_base::get_inst_coverage;
+
   /*!
    *  \brief Computes coverage count across all instances of this type
    *  \returns Coverage percentage of this instance
@@ -309,7 +850,7 @@ public:
    * \param total Total number of bins in this covergroup
    * \returns Coverage percentage of this instance
    */
-  double get_coverage(int &bins_covered, int &total, fc4sc::global* cvg_cntxt = nullptr)
+  double get_coverage(uint64_t &bins_covered, uint64_t &total, fc4sc::global* cvg_cntxt = nullptr)
   {
     if(cvg_cntxt == nullptr)
     {
@@ -323,6 +864,19 @@ public:
     return fc4sc::global::get_coverage(this->scp_type_name(), this->type_name(), bins_covered, total, cvg_cntxt);
   }
 
+  /*!
+   * \brief int version of get_coverage(uint64_t&, uint64_t&, global*), kept
+   * for source compatibility. Counts past INT_MAX are reported as INT_MAX
+   */
+  double get_coverage(int &bins_covered, int &total, fc4sc::global* cvg_cntxt = nullptr)
+  {
+    uint64_t bins_covered64 = 0, total64 = 0;
+    double res = get_coverage(bins_covered64, total64, cvg_cntxt);
+    bins_covered = saturate_to_int(bins_covered64);
+    total = saturate_to_int(total64);
+    return res;
+  }
+
   /*!
    * \brief Enables sampling on all coverpoints/crosses
    */
@@ -504,10 +1058,10 @@ public:
     dyn_cvp->cvp_data->sample_expression_str = "dynamic sample";
     dyn_cvp->cvp_data->sample_condition_str = "dynamic sample";
     dyn_cvp->sample_condition = [](){ return true; };
-    this->cvps.push_back(dyn_cvp);
-
     dynamic_coverpoint_factory<T,bool()> dyn_cvp_fact;
     dyn_cvp_fact.cvp_fact = dyn_cvp;
+    dyn_cvp_fact.cvp_slot = this->cvps.size();
+    this->cvps.push_back(dyn_cvp);
     dyn_cvp_fact.sample_expression = sample_expr;
     dyn_cvp_fact.sample_condition = [](){ return true; };
     return dyn_cvp_fact;
@@ -534,10 +1088,10 @@ public:
     dyn_cvp->has_sample_expression = true;
     dyn_cvp->cvp_data->sample_expression_str = "dynamic sample";
     dyn_cvp->cvp_data->sample_condition_str = "dynamic sample";
-    this->cvps.push_back(dyn_cvp);
-
     dynamic_coverpoint_factory<T,U> dyn_cvp_fact;
     dyn_cvp_fact.cvp_fact = dyn_cvp;
+    dyn_cvp_fact.cvp_slot = this->cvps.size();
+    this->cvps.push_back(dyn_cvp);
     dyn_cvp_fact.sample_expression = sample_expr;
     dyn_cvp_fact.sample_condition = cond_expr;
     return dyn_cvp_fact;
@@ -554,6 +1108,25 @@ public:
     internal_add_cross(crs_name,(args.cvp_fact)...);
   }
 
+  /*!
+   * \brief Add a cross of coverpoints chosen at runtime to dynamic_covergroup
+   * type, e.g. from a configuration file
+   * \param crs_name Cross name
+   * \param cvp_names Names of the crossed coverpoints, created before
+   */
+  void add_cross(std::string crs_name, std::vector<std::string> cvp_names)
+  {
+    std::vector<cvp_base*> crossed;
+    for (auto& cvp_name : cvp_names) {
+      auto it = std::find_if(this->cvps.begin(), this->cvps.end(),
+        [&cvp_name](cvp_base* cvp) { return cvp->name() == cvp_name; });
+      if (it == this->cvps.end())
+        throw ("Cannot cross unknown coverpoint " + cvp_name + " in covergroup " + this->type_name);
+      crossed.push_back(*it);
+    }
+    this->cvps.push_back(new dynamic_cross(crs_name, crossed));
+  }
+
   /*!
    * \brief Helper function to add cross to covergroup
    */
@@ -589,6 +1162,7 @@ public:
     for (auto cvp_it : cvg_type.cvps) 
     {
       cvp_base* next_cvp = cvp_it->create_instance(this);
+      next_cvp->prototype = cvp_it;
       this->cvg_base::register_cvp(next_cvp);
       this->get_cvg_data()->add_cvp_data(next_cvp->get_data());
     }
@@ -601,6 +1175,7 @@ public:
     for (auto cvp_it : cvg_type.cvps) 
     {
       cvp_base* next_cvp = cvp_it->create_instance(this);
+      next_cvp->prototype = cvp_it;
       this->cvg_base::register_cvp(next_cvp);
       this->get_cvg_data()->add_cvp_data(next_cvp->get_data());
     }
@@ -609,6 +1184,7 @@ public:
   
   void disable_cvg() {
     get_cvg_data()->enable = false;
+    get_cvg_data()->coverage.invalidate();
   }
 
   ~dynamic_covergroup()
@@ -40,8 +40,11 @@
 #include <functional>
 #include <tuple>
 #include <algorithm> // std::find
+#include <cstring>
+#include <mutex>
 
 #include "fc4sc_bin.hpp"
+#include "fc4sc_index.hpp"
 
 namespace fc4sc
 {
@@ -85,7 +88,7 @@ public:
   std::string sample_condition_str;
 
   uint64_t size() const {
-    return bins_data.size();
+    return bin_count();
   }
 
   std::string& get_sample_expression_str()
@@ -149,7 +152,47 @@ private:
   std::function<T()> sample_expression;
 
   /*!
-   *  \brief Create a dynamic copy of this coverpoint with matching bin types
+   *  \brief Creates bins of an instance of another coverpoint, sharing the
+   *  definitions of the bins in from
+   *  \param to_data Data created in this coverpoint for the bins in from
+   */
+  template <class bin_type>
+  void instance_bins(const std::vector<bin_type>& from, std::vector<bin_type>& to,
+                     const std::vector<bin_base_data_model*>& to_data)
+  {
+    to.reserve(from.size());
+    for (size_t i = 0; i < from.size(); ++i)
+    {
+      to.push_back(from[i]);
+      to.back().bin_data = static_cast<bin_data_model<T>*>(to_data[i]);
+      to.back().valid_data = to_data[i]->valid;
+    }
+  }
+
+  /*!
+   *  \brief Gives this coverpoint, which has no bins yet, the bins of proto.
+   *  The bin definitions and the bin lookup are shared with proto. This
+   *  coverpoint owns the counters and a bin and its data per bin of proto
+   */
+  void instance_of(coverpoint<T>& proto)
+  {
+    // compiled once here, every instance then uses this lookup
+    if (proto.index_dirty) proto.build_index();
+
+    cvp_data->hit_counters.resize(proto.cvp_data->hit_counters.size(), 0);
+    cvp_data->create_bins_data(proto.cvp_data->bins_data, cvp_data->bins_data);
+    cvp_data->create_bins_data(proto.cvp_data->illegal_bins_data, cvp_data->illegal_bins_data);
+    cvp_data->create_bins_data(proto.cvp_data->ignore_bins_data, cvp_data->ignore_bins_data);
+    instance_bins(proto.bins, bins, cvp_data->bins_data);
+    instance_bins(proto.illegal_bins, illegal_bins, cvp_data->illegal_bins_data);
+    instance_bins(proto.ignore_bins, ignore_bins, cvp_data->ignore_bins_data);
+    lookup = proto.lookup;
+  }
+
+  /*!
+   *  \brief Create a dynamic copy of this coverpoint with matching bin types.
+   *  The copy shares the bin definitions and the bin lookup with this
+   *  coverpoint and only owns its counters
    */
   cvp_base* create_instance(cvg_base* cvg_inst)
   {
@@ -158,47 +201,116 @@ private:
     cvp->cvp_data->option = this->option();
     cvp->cvp_data->sample_expression_str = this->get_sample_expression_str();
     cvp->cvp_data->sample_condition_str = this->get_sample_condition_str();
-    for(auto& bin_it : this->bins)
-    {
-      auto new_bin_data = new bin_data_model<T>;
-      cvp->bins.push_back(bin_it);
-      cvp->bins.back().bin_data = new_bin_data;
-      cvp->cvp_data->bins_data.push_back(new_bin_data);
-      *new_bin_data = *(bin_it.bin_data);
-      std::fill(new_bin_data->interval_hits.begin(),new_bin_data->interval_hits.end(),0);
-    }
-    for(auto& bin_it : this->illegal_bins)
-    {
-      auto new_bin_data = new bin_data_model<T>;
-      cvp->illegal_bins.push_back(bin_it);
-      cvp->illegal_bins.back().bin_data = new_bin_data;
-      *new_bin_data = *(bin_it.bin_data);
-      cvp->cvp_data->illegal_bins_data.push_back(new_bin_data);
-      std::fill(new_bin_data->interval_hits.begin(),new_bin_data->interval_hits.end(),0);
-    }
-    for(auto& bin_it : this->ignore_bins)
-    {
-      auto new_bin_data = new bin_data_model<T>;
-      cvp->ignore_bins.push_back(bin_it);
-      cvp->ignore_bins.back().bin_data = new_bin_data;
-      *new_bin_data = *(bin_it.bin_data);
-      cvp->cvp_data->ignore_bins_data.push_back(new_bin_data);
-      std::fill(new_bin_data->interval_hits.begin(),new_bin_data->interval_hits.end(),0);
-    }
+    cvp->instance_of(*this);
 
     cvp->has_sample_expression = this->has_sample_expression;
     cvp->sample_expression = this->sample_expression;
     cvp->sample_condition = this->sample_condition;
-    
-    cvp->regular_interval_map = this->regular_interval_map;
-    cvp->illegal_interval_map = this->illegal_interval_map;
-    cvp->ignore_interval_map = this->ignore_interval_map;
+    cvp->inline_sample = this->inline_sample;
+    cvp->inline_sample_ctx = this->inline_sample_ctx;
     return cvp;
   }
 
+  /*!
+   * Bins of a coverpoint declared with the COVERPOINT macro, built from the
+   * bin declarations by the first instance of the covergroup type and shared
+   * by the later instances, which skip the declarations
+   */
+  struct bin_schema {
+    /*! Guards setting proto */
+    std::mutex mutex;
+
+    /*! Coverpoint holding the bins, never sampled. nullptr until built */
+    std::atomic<coverpoint<T>*> proto{nullptr};
+
+    ~bin_schema()
+    {
+      coverpoint<T>* built = proto.load();
+      if (!built) return;
+      delete built->cvp_data;
+      delete built;
+    }
+  };
+
+  /*! Schema the bins of this coverpoint are shared through, if any */
+  bin_schema* schema = nullptr;
+
+  /*! Coverpoint holding the bins of this one: the schema's, or this one */
+  coverpoint<T>& declared()
+  {
+    return cvp_data->schema_data ? *schema->proto.load() : *this;
+  }
+
+  /*!
+   *  \brief Makes this coverpoint, which has no bins, count the hits of the
+   *  bins of the schema. Only the counters are allocated, the bins, their
+   *  data and the bin lookup are the schema's
+   */
+  void share_schema()
+  {
+    coverpoint<T>& proto = *schema->proto.load();
+    cvp_data->schema_data = proto.cvp_data;
+    cvp_data->hit_counters.resize(proto.cvp_data->hit_counters.size(), 0);
+    lookup = proto.lookup;
+  }
+
+  /*!
+   *  \brief Creates the bins of a coverpoint sharing a schema, and their
+   *  data, for introspection. Nothing is done if they exist
+   */
+  void create_bins()
+  {
+    if (!cvp_data->schema_data || bins.size() + illegal_bins.size() + ignore_bins.size() != 0) return;
+    cvp_data->create_bins_data();
+    coverpoint<T>& proto = declared();
+    instance_bins(proto.bins, bins, cvp_data->bins_data);
+    instance_bins(proto.illegal_bins, illegal_bins, cvp_data->illegal_bins_data);
+    instance_bins(proto.ignore_bins, ignore_bins, cvp_data->ignore_bins_data);
+  }
+
+  /*!
+   *  \brief Makes a coverpoint sharing a schema hold bins of its own, which
+   *  bins can be added to. The bin definitions stay shared
+   */
+  void own_bins()
+  {
+    if (!cvp_data->schema_data) return;
+    create_bins();
+    cvp_data->schema_data = nullptr;
+  }
+
+  /*!
+   *  \brief Builds the schema from the bins of rh, unless another instance
+   *  of the covergroup type built it first, then shares it
+   *  \param rh Coverpoint holding the bins of the COVERPOINT declaration
+   */
+  void build_schema(coverpoint<T>&& rh)
+  {
+    std::unique_ptr<coverpoint<T>> built(new coverpoint<T>);
+    *built = std::move(rh);
+    built->build_index();
+    {
+      std::lock_guard<std::mutex> lock(schema->mutex);
+      if (!schema->proto.load())
+        schema->proto.store(built.release());
+    }
+    if (built) delete built->cvp_data;
+    share_schema();
+  }
+
   /*! Condition based on which the sampling takes place or not */
   std::function<bool()> sample_condition;
 
+  /*!
+   * Evaluates the sample condition and, if met, the sample expression into
+   * its second argument. Set by the COVERPOINT macro and used instead of
+   * sample_condition and sample_expression, saving the type erased calls
+   */
+  bool (*inline_sample)(void*, T&) = nullptr;
+
+  /*! Covergroup inline_sample is called with */
+  void* inline_sample_ctx = nullptr;
+
   // pointer sample variable (assigned via SAMPLE_POINT macro)
   T* sample_point = nullptr;
 
@@ -229,7 +341,7 @@ private:
     unsigned int i = 0;
     std::vector<bin_range_t> entry{ {0,i} };
     auto& elem_entry = entry[0];
-    for(auto it = bin.bin_data->intervals.begin();it != bin.bin_data->intervals.end(); it++)
+    for(auto it = bin.bin_data->get_intervals().begin();it != bin.bin_data->get_intervals().end(); it++)
     {
       map_it = interval_map.insert(map_it,{*it, entry }); 
       elem_entry.second = ++i;
@@ -325,80 +437,156 @@ private:
    */
   void insert_intervals(interval_map_t& interval_map, bin<T>& new_bin, unsigned int bin_key)
   {
+    index_dirty = true;
+    lookup->compiled = false;
+    cvp_data->covered_valid = false;
+    cvp_data->coverage_changed();
     if(interval_map.empty()) {
       build_interval_map(interval_map,new_bin);
       return;
     }
     auto hint_it = interval_map.begin();
     unsigned int i = 0;
-    for(auto bin_it = new_bin.bin_data->intervals.begin(); bin_it != new_bin.bin_data->intervals.end(); bin_it++)
+    for(auto bin_it = new_bin.bin_data->get_intervals().begin(); bin_it != new_bin.bin_data->get_intervals().end(); bin_it++)
     {
       hint_it = slice_intervals_map(hint_it,interval_map,*bin_it);
       hint_it = add_range_map(hint_it,interval_map,{bin_key,i++},*bin_it);
     }
   }
 
-  /*! Flat map representation of coverpoint's bin for binary search sampling */
-  interval_map_t regular_interval_map;
+  /*!
+   * Bin lookup of the coverpoint, built from the bins. Shared by the instances
+   * of a dynamic coverpoint, whose bins are at the same counter positions
+   */
+  struct bin_lookup {
+    /*! Flat map representation of coverpoint's bin for binary search sampling */
+    interval_map_t regular_interval_map;
+
+    /*! Flat map representation of coverpoint's bin for binary search sampling */
+    interval_map_t illegal_interval_map;
+
+    /*! Flat map representation of coverpoint's bin for binary search sampling */
+    interval_map_t ignore_interval_map;
 
-  /*! Flat map representation of coverpoint's bin for binary search sampling */
-  interval_map_t illegal_interval_map;
+    /*! All three interval maps merged and compiled, searched when sampling */
+    interval_index<T> index;
 
-  /*! Flat map representation of coverpoint's bin for binary search sampling */
-  interval_map_t ignore_interval_map;
+    /*! Set once index is compiled from the current interval maps */
+    bool compiled = false;
+
+    /*! Bound on the dense lookup table index was compiled with */
+    size_t dense_max_bytes = 0;
+  };
+
+  /*! Built with the first bin, or shared */
+  std::shared_ptr<bin_lookup> lookup;
+
+  /*! Set whenever the bins change and build_index() must be called */
+  bool index_dirty = true;
+
+  /*! Bin lookup of this coverpoint, copied first if it is shared */
+  bin_lookup& own_lookup()
+  {
+    if (!lookup) lookup = std::make_shared<bin_lookup>();
+    else if (lookup.use_count() > 1) lookup = std::make_shared<bin_lookup>(*lookup);
+    return *lookup;
+  }
+
+  /*!
+   *  \brief Compiles the interval maps into the flat index used for sampling,
+   *  unless a shared lookup was already compiled, and sizes the counters.
+   *  If the bins span a small value domain the index also gets a dense lookup
+   *  table, bounded by option.dense_lookup_max_bytes
+   */
+  void build_index()
+  {
+    if (!lookup || !lookup->compiled || lookup->dense_max_bytes != cvp_data->option.dense_lookup_max_bytes) {
+      bin_lookup& l = own_lookup();
+      l.dense_max_bytes = cvp_data->option.dense_lookup_max_bytes;
+      l.index.build(l.ignore_interval_map, l.illegal_interval_map, l.regular_interval_map,
+                    l.dense_max_bytes);
+      coverpoint<T>& defs = declared();
+      for (auto& ref : l.index.refs) {
+        bin_data_model<T>* data = (ref.type == default_) ? defs.bins[ref.bin].bin_data :
+                                  (ref.type == illegal_) ? defs.illegal_bins[ref.bin].bin_data :
+                                                           defs.ignore_bins[ref.bin].bin_data;
+        ref.counter = data->hits_offset + ref.interval;
+      }
+      l.compiled = true;
+    }
+    for (auto& shard : cvp_data->shard_counters)
+      shard.resize(cvp_data->hit_counters.size(), 0);
+    cvp_data->recount_covered();
+    index_dirty = false;
+  }
  
   /*!
    *  \brief Sampling function at coverpoint level
    *  \param cvp_val Value to be sampled for this coverpoint
+   *  \param shard Shard to count the sample in
    *
    *  Takes a value and searches it in the owned bins
    */
-  void sample(const T &cvp_val)  {
+  void sample(const T &cvp_val, size_t shard)  {
 #ifdef FC4SC_DISABLE_SAMPLING
     return;
 #endif
     if (!collect) return;
-    this->last_sample_success = false;
-
-    // 1) Search if the value is in the ignore bins
-    auto range_it  = get_interval_bs(this->ignore_interval_map,cvp_val);
-    if(range_it != this->ignore_interval_map.end()) {
-      for(auto bin_range_it : range_it->second)
-      {
-        if (this->ignore_bins[bin_range_it.first].sample(cvp_val,bin_range_it.second)) {
-          cvp_data->misses++;
-          return;
-        }
-      }
-    }
+    if (index_dirty) build_index();
+    sample_found(cvp_val, lookup->index.find(cvp_val), shard);
+  }
 
-    // 2) Search if the value is in the illegal bins
-    range_it  = get_interval_bs(this->illegal_interval_map,cvp_val);
-    if(range_it != this->illegal_interval_map.end()) {
-      for(auto bin_range_it : range_it->second)
-      {
-        try { this->illegal_bins[bin_range_it.first].sample(cvp_val,bin_range_it.second); }
-        catch (illegal_bin_sample_exception &e) {
-          e.update_cvp_info(this->cvp_data->name);
-          throw e;
-        }
-      }
-    }
+  /*! Number of values looked up together by sample_batch */
+  static constexpr size_t sample_batch_block = 64;
 
-    // 3) Sample regular bins    
-    range_it  = get_interval_bs(this->regular_interval_map,cvp_val);
-    if(range_it != this->regular_interval_map.end()) {
-      for(auto bin_range_it : range_it->second)
+  /*!
+   *  \brief Updates the bins for a value whose index lookup is already done
+   *  \param cvp_val Value to be sampled for this coverpoint
+   *  \param pos Range of cvp_val in the index
+   *  \param shard Shard to count the sample in
+   *
+   *  The references of a range come ignore bins first, then illegal bins,
+   *  then regular bins, which is the order they take precedence in. Every
+   *  value of the range is inside the referenced intervals, so the hit
+   *  counters are incremented directly. Unless sampling is sharded, the
+   *  covered bins count is updated when a regular bin reaches the at_least
+   *  threshold it was counted for.
+   */
+  void sample_found(const T &cvp_val, size_t pos, size_t shard)  {
+    bool& success = this->sample_success(shard);
+    bin_hit_list& hit = this->bins_hit(shard);
+    counter_t* counters = cvp_data->counters(shard).data();
+    success = false;
+    hit.clear();
+
+    if(pos != interval_index<T>::npos) {
+      for(auto ref = lookup->index.refs_begin(pos); ref != lookup->index.refs_end(pos); ++ref)
       {
-        if (this->bins[bin_range_it.first].sample(cvp_val,bin_range_it.second)) {
-          this->last_bin_index_hit = bin_range_it.first;
-          this->last_sample_success = true;
+        switch (ref->type) {
+        case ignore_:
+          counters[ref->counter]++;
+          cvp_data->shard_miss(shard)++;
+          return;
+        case illegal_:
+          counters[ref->counter]++;
+          handle_illegal_hit(illegal_bin_hit(this->cvg_name, this->cvp_data->name,
+                                             declared().illegal_bins[ref->bin].bin_data->get_name(),
+                                             &cvp_val, &format_sample_value<T>));
+          return;
+        default:
+          counters[ref->counter]++;
+          if (!cvp_data->sharded() && count_hit(cvp_data->bin_hits[ref->bin]) == cvp_data->covered_at_least)
+            cvp_data->bin_covered();
+          hit.push(ref->bin);
+          success = true;
           if (this->stop_sample_on_first_bin_hit) return;
         }
       }
     }
-    
-    if (!this->last_sample_success) { cvp_data->misses++; }
+
+    if (!success) { cvp_data->shard_miss(shard)++; }
+    else if (hit.truncated)
+      cvp_data->sample_truncated("hit more than FC4SC_MAX_HIT_BINS bins in one sample, crosses only combine the first ones");
   }
 
   /*! Default constructor */
@@ -412,7 +600,7 @@ private:
   {
     if (!n.is_empty())
     {
-      std::reverse(n.bin_data->intervals.begin(), n.bin_data->intervals.end());
+      std::reverse(n.bin_data->get_intervals().begin(), n.bin_data->get_intervals().end());
       //bins.push_back(n);
       n.add_to_cvp(*this);
     }
@@ -435,7 +623,7 @@ private:
   {
     if (!n.is_empty())
     {
-      std::reverse(n.bin_data->intervals.begin(), n.bin_data->intervals.end());
+      std::reverse(n.bin_data->get_intervals().begin(), n.bin_data->get_intervals().end());
       //illegal_bins.push_back(n);
       n.add_to_cvp(*this);
     }
@@ -449,7 +637,7 @@ private:
   {
     if (!n.is_empty())
     {
-      std::reverse(n.bin_data->intervals.begin(), n.bin_data->intervals.end());
+      std::reverse(n.bin_data->get_intervals().begin(), n.bin_data->get_intervals().end());
       //ignore_bins.push_back(n);
       n.add_to_cvp(*this);
     }
@@ -478,13 +666,29 @@ public:
      * the bins. This is a needed assumption which makes the COVERPOINT macro
      * syntax work!
      */
+    if (this->schema) {
+      // the bins of the COVERPOINT declaration, unless the schema was
+      // shared while they were declared
+      if (this->cvp_data->schema_data) delete rh.cvp_data;
+      else build_schema(std::move(rh));
+      return *this;
+    }
     this->bins = std::move(rh.bins);
     this->ignore_bins = std::move(rh.ignore_bins);
     this->illegal_bins = std::move(rh.illegal_bins);
-    this->regular_interval_map = std::move(rh.regular_interval_map);
-    this->illegal_interval_map = std::move(rh.illegal_interval_map);
-    this->ignore_interval_map = std::move(rh.ignore_interval_map);
-
+    this->lookup = rh.lookup;
+    this->index_dirty = true;
+
+    this->cvp_data->covered_valid = false;
+    this->cvp_data->coverage_changed();
+    this->cvp_data->hit_counters = std::move(rh.cvp_data->hit_counters);
+    this->cvp_data->shard_counters = std::move(rh.cvp_data->shard_counters);
+    for (auto& bin_it : this->bins)
+      bin_it.bin_data->rebind_hits(this->cvp_data->hit_counters, this->cvp_data->shard_counters);
+    for (auto& bin_it : this->illegal_bins)
+      bin_it.bin_data->rebind_hits(this->cvp_data->hit_counters, this->cvp_data->shard_counters);
+    for (auto& bin_it : this->ignore_bins)
+      bin_it.bin_data->rebind_hits(this->cvp_data->hit_counters, this->cvp_data->shard_counters);
     this->cvp_data->bins_data = rh.cvp_data->bins_data;
     this->cvp_data->illegal_bins_data = rh.cvp_data->illegal_bins_data;
     this->cvp_data->ignore_bins_data = rh.cvp_data->ignore_bins_data;
@@ -495,7 +699,10 @@ public:
     return *this;
   }
 
-  ~coverpoint() = default;
+  ~coverpoint()
+  {
+    this->stop_async_worker();
+  }
 
   /*!
    * \brief Initializer list constructor that receives a list of bin (of any types,
@@ -531,14 +738,18 @@ public:
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
-    return bins.size();
+    return cvp_data->bin_count();
   }
 
-  void sample() 
+  /*!
+   *  \brief Evaluates the sample condition and the sample expression
+   *  \param val Receives the sampled value
+   *  \returns False if the sample condition is not met
+   */
+  bool read_sample(T& val)
   {
-    if(valid_data.use_count() == 0) {
-      std::cerr << "Error: coverage data has been deleted\n";
-      throw("Error: coverage data has been deleted");
+    if (inline_sample) {
+      return inline_sample(inline_sample_ctx, val);
     }
     if (has_sample_expression) {
       bool cond;
@@ -549,24 +760,134 @@ public:
 	std::cerr << "sample_condition is not binded for coverpoint " << this->cvp_data->name << "\n";
 	throw e;
       }
-      if (cond) {
-        try {
-          this->sample(sample_expression());
-	} catch(const std::exception& e) {
-	  std::cerr << e.what() << "\n";
-	  std::cerr << "sample_expression is not binded for coverpoint " << this->cvp_data->name << "\n";
-	  throw e;
-	}
-      }
-      else {
-        // This is a fix so that crosses are not sampled if any of the coverpoints
-        // used for crossing has a sample condition which is not met.
-        this->last_sample_success = false;
-        this->last_bin_index_hit = 0;
+      if (!cond) return false;
+      try {
+        val = sample_expression();
+      } catch(const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        std::cerr << "sample_expression is not binded for coverpoint " << this->cvp_data->name << "\n";
+        throw e;
       }
+      return true;
+    }
+    val = *sample_point;
+    return true;
+  }
+
+  /*!
+   *  \brief Counts a value read by read_sample()
+   *  \param cond Result of read_sample()
+   *  \param val Value read by read_sample()
+   *  \param shard Shard sampled into
+   */
+  void sample_read(bool cond, const T& val, size_t shard)
+  {
+    if (cond) {
+      this->sample(val, shard);
     }
     else {
-      this->sample(*sample_point);
+      // This is a fix so that crosses are not sampled if any of the coverpoints
+      // used for crossing has a sample condition which is not met.
+      this->sample_success(shard) = false;
+      this->bins_hit(shard).clear();
+    }
+  }
+
+  void sample() 
+  {
+    FC4SC_CHECK_MEMBER_SAMPLE(valid_data);
+    T val = T();
+    bool cond = read_sample(val);
+    sample_read(cond, val, this->current_shard());
+  }
+
+  /*! Sampled values, integral, are copied bytewise to the sample queue */
+  bool can_capture() const
+  {
+    return true;
+  }
+
+  /*! The sampled value followed by the result of the sample condition */
+  size_t capture_size() const
+  {
+    return sizeof(T) + 1;
+  }
+
+  void capture_sample(unsigned char* record)
+  {
+    T val = T();
+    record[sizeof(T)] = read_sample(val);
+    std::memcpy(record, &val, sizeof(T));
+  }
+
+  void sample_captured(const unsigned char* record)
+  {
+    T val = T();
+    std::memcpy(&val, record, sizeof(T));
+    sample_read(record[sizeof(T)] != 0, val, this->current_shard());
+  }
+
+  void lookup_captured(const unsigned char* records, size_t stride, size_t n,
+                       size_t* pos, size_t pos_stride)
+  {
+    if (index_dirty) build_index();
+    T vals[sample_batch_block];
+    size_t found[sample_batch_block];
+    for (size_t first = 0; first < n; first += sample_batch_block)
+    {
+      size_t len = std::min(sample_batch_block, n - first);
+      for (size_t i = 0; i < len; ++i)
+        std::memcpy(&vals[i], records + (first + i) * stride, sizeof(T));
+      lookup->index.find_batch(vals, len, found);
+      for (size_t i = 0; i < len; ++i)
+        pos[(first + i) * pos_stride] = found[i];
+    }
+  }
+
+  void sample_found_captured(const unsigned char* record, size_t pos)
+  {
+    if (!record[sizeof(T)]) {
+      sample_read(false, T(), this->current_shard());
+      return;
+    }
+#ifdef FC4SC_DISABLE_SAMPLING
+    return;
+#endif
+    if (!collect) return;
+    T val = T();
+    std::memcpy(&val, record, sizeof(T));
+    sample_found(val, pos, this->current_shard());
+  }
+
+  /*!
+   *  \brief Samples an array of values
+   *  \param values Pointer to the first value
+   *  \param n Number of values
+   *
+   *  Has the same effect on the bins as sampling every value in order, but
+   *  skips the sample expression and condition. Values are looked up in the
+   *  index one block at a time, in loops without side effects the compiler
+   *  can vectorize, before the counters of the block are updated.
+   *  Crosses are not sampled.
+   */
+  void sample_batch(const T* values, size_t n)
+  {
+    FC4SC_CHECK_CVG_SAMPLE(valid_data);
+#ifdef FC4SC_DISABLE_SAMPLING
+    return;
+#endif
+    if (!collect) return;
+    if (index_dirty) build_index();
+
+    size_t shard = this->current_shard();
+    size_t pos[sample_batch_block];
+
+    for (size_t first = 0; first < n; first += sample_batch_block)
+    {
+      size_t len = std::min(sample_batch_block, n - first);
+      lookup->index.find_batch(values + first, len, pos);
+      for (size_t i = 0; i < len; ++i)
+        sample_found(values[first + i], pos[i], shard);
     }
   }
 
@@ -581,14 +902,11 @@ public:
       throw("Error: coverage data has been deleted");
     }
 
-    if (bins.empty()) // no bins defined
+    if (cvp_data->bin_count() == 0) // no bins defined
       return (cvp_data->option.weight == 0) ? 100 : 0;
 
-    double res = 0;
-    for (auto &bin : bins)
-      res += (bin.get_hitcount() >= cvp_data->option.at_least);
-
-    double real = res * 100 / bins.size();
+    double res = cvp_data->get_covered_bins();
+    double real = res * 100 / cvp_data->bin_count();
 
     return (real >= this->cvp_data->option.goal) ? 100 : real;
   }
@@ -599,7 +917,7 @@ public:
    *  \param total Total number of bins in this coverpoint
    *  \returns Coverage value as a double between 0 and 100
    */
-  double get_inst_coverage(int &covered, int &total) const 
+  double get_inst_coverage(uint64_t &covered, uint64_t &total) const 
   {
     if(valid_data.use_count() == 0) {
       std::cerr << "Error: coverage data has been deleted\n";
@@ -608,22 +926,23 @@ public:
 
     double res = 0;
     covered = 0;
-    total = bins.size();
+    total = cvp_data->bin_count();
 
-    if (!bins.size())
+    if (!total)
     {
       total = 0;
       return (cvp_data->option.weight == 0) ? 100 : 0;
     }
 
-    for (auto &bin : bins)
-      res += (bin.get_hitcount() >= cvp_data->option.at_least);
-
+    res = cvp_data->get_covered_bins();
     covered = res;
     double real = res * 100 / total;
     return (real >= this->cvp_data->option.goal) ? 100 : real;
   }
 
+  /*! int version of get_inst_coverage(uint64_t&, uint64_t&) */
+  using api_base::get_inst_coverage;
+
   /*!
    *  \brief Retrieves the number of hits of the bin with a particular index.
    *  The index order is the same as in the declaration of the coverpoint.
@@ -637,15 +956,18 @@ public:
       throw("Error: coverage data has been deleted");
     }
 
-    if (bin_index >= bins.size()) {// bin index out of bounds
+    if (bin_index >= cvp_data->bin_count()) {// bin index out of bounds
       std::cerr << "FC4SC " << __FUNCTION__ << ": Error! bin_index argument "
           "is out of bounds. Passed value: [" << bin_index << "]" << std::endl
-          << "Coverpoint [" << this->cvp_data->name << "] has [" << bins.size()
+          << "Coverpoint [" << this->cvp_data->name << "] has [" << cvp_data->bin_count()
           << "] bins!" << std::endl;
       return 0;
     }
 
-    return (this->bins[bin_index].get_hitcount());
+    uint64_t hitsum = 0;
+    for (auto hitcount : cvp_data->declared_bins()[bin_index]->get_interval_hits(cvp_data->hit_counters, &cvp_data->shard_counters))
+      hitsum += hitcount;
+    return hitsum;
   }
 
   /*!
@@ -710,7 +1032,50 @@ public:
       throw("Error: coverage data has been deleted");
     }
 
-    return cvp_data->misses;
+    return cvp_data->total_misses();
+  }
+
+  /*!
+   * \brief Compiles the sampling index if the bins changed since it was built
+   */
+  void prepare_sample()
+  {
+    if (index_dirty) build_index();
+    cvp_data->stop_at_goal = cvp_data->option.stop_at_goal;
+    cvp_data->at_goal_sample_period = cvp_data->option.at_goal_sample_period;
+  }
+
+  /*! Samples a group of coverpoints of this type without virtual calls */
+  static void sample_group_of(cvp_base* const* cvps, size_t n, size_t& next)
+  {
+    for (; next < n; ++next)
+      static_cast<coverpoint<T>*>(cvps[next])->coverpoint<T>::sample();
+  }
+
+  sample_group_fn sample_group() const
+  {
+    return &coverpoint<T>::sample_group_of;
+  }
+
+  /*!
+   *  \brief Sets the number of shards sampled into. Counts of removed shards
+   *  are added to shard 0
+   *  \param shards Number of shards, 1 disables sharding
+   */
+  void set_shards(size_t shards)
+  {
+    if (shards == 0) shards = 1;
+    if (index_dirty) build_index();
+    for (size_t s = shards; s < this->shard_states.size() + 1; ++s) {
+      for (size_t i = 0; i < cvp_data->hit_counters.size(); ++i)
+        cvp_data->hit_counters[i] += cvp_data->shard_counters[s - 1][i];
+      cvp_data->misses += cvp_data->shard_misses[s - 1].value;
+    }
+    this->shard_states.resize(shards - 1);
+    cvp_data->shard_misses.resize(shards - 1);
+    cvp_data->shard_counters.resize(shards - 1, std::vector<counter_t>(cvp_data->hit_counters.size(), 0));
+    cvp_data->covered_valid = false;
+    cvp_data->coverage_changed();
   }
 
   /*!
@@ -731,6 +1096,7 @@ public:
    */
   std::vector<bin_base*> get_bins_base()
   {
+    create_bins();
     std::vector<bin_base*> bin_base_vec;
     for (auto &bin_it : bins)
     {
@@ -744,6 +1110,7 @@ public:
    */
   std::vector<bin_base*> get_illegal_bins_base()
   {
+    create_bins();
     std::vector<bin_base*> bin_base_vec;
     for (auto &bin_it : illegal_bins)
     {
@@ -757,6 +1124,7 @@ public:
    */
   std::vector<bin_base*> get_ignore_bins_base()
   {
+    create_bins();
     std::vector<bin_base*> bin_base_vec;
     for (auto &bin_it : ignore_bins)
     {
@@ -777,6 +1145,9 @@ public:
 
 };
 
+template <class T>
+constexpr size_t coverpoint<T>::sample_batch_block;
+
 /*!
  * \brief Defines a class to manage coverpoints in
  * dynamically defined covergroup
@@ -797,8 +1168,27 @@ static_assert(std::is_same<bool,cond_ret_type>::value,"sample condition expressi
 
   coverpoint<ret_type>* cvp_fact;
 
+  /*! Position of cvp_fact among the objects of its covergroup type */
+  size_t cvp_slot = 0;
+
 public:
 
+  /*!
+   * \brief Instance of this coverpoint in a covergroup. Found by position
+   * when cvg is an instance of the covergroup type this coverpoint was
+   * created in, else by name
+   * \param cvg Covergroup instance
+   */
+  coverpoint<ret_type>& instance(cvg_base& cvg)
+  {
+    if (cvp_slot < cvg.cvps.size() && cvg.cvps[cvp_slot]->prototype == cvp_fact)
+      return *static_cast<coverpoint<ret_type>*>(cvg.cvps[cvp_slot]);
+    coverpoint<ret_type>* cvp = dynamic_cast< coverpoint<ret_type>* >(&cvg.get_coverpoint(cvp_fact->cvp_data->name));
+    if (!cvp)
+      throw ("Coverpoint " + cvp_fact->cvp_data->name + " in covergroup " + cvg.name() + " has another type");
+    return *cvp;
+  }
+
   /*!
    * \brief binds variables to sample expression
    * \param Args must be same type as args for sample
@@ -808,8 +1198,7 @@ public:
   void bind_sample(cvg_base& cvg, Args&... args)
   {
     static_assert(std::is_same<T,ret_type(Args...)>::value,"Argument variables must match coverpoint sample expression");
-    cvp_base& cp_base = cvg.get_coverpoint(cvp_fact->cvp_data->name);
-    coverpoint<ret_type>* cvp = dynamic_cast< coverpoint<ret_type>* >(&cp_base);
+    coverpoint<ret_type>* cvp = &instance(cvg);
     if( cvp->sample_expression ) 
       throw ("Attempted to bind sample expression that is already binded in coverpoint " + cvp->cvp_data->name + " in covergroup " + cvg.name());
     cvp->sample_expression = std::bind(sample_expression,std::ref(args)...);
@@ -825,8 +1214,7 @@ public:
   void bind_condition(cvg_base& cvg, Args&... args)
   {
     static_assert(std::is_same<U,bool(Args...)>::value,"Argument variables must match coverpoint sample condition expression");
-    cvp_base& cp_base = cvg.get_coverpoint(cvp_fact->cvp_data->name);
-    coverpoint<ret_type>* cvp = dynamic_cast< coverpoint<ret_type>* >(&cp_base);
+    coverpoint<ret_type>* cvp = &instance(cvg);
     if( cvp->sample_condition ) 
       throw ("Attempted to bind sample condition that is already binded in coverpoint " + cvp->name() + " in covergroup " + cvg.name());
     cvp->sample_condition = std::bind(sample_condition,std::ref(args)...);
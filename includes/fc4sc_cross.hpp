@@ -35,9 +35,15 @@
 #define FC4SC_CROSS_HPP
 
 #include <tuple>
+#include <array>
+#include <mutex>
+#include <sstream>
+#include <algorithm>
+#include <typeinfo>
 #include "fc4sc_base.hpp"
 #include "fc4sc_bin.hpp"
 #include "fc4sc_coverpoint.hpp"
+#include "fc4sc_cross_storage.hpp"
 #include "fc4sc_binsof.hpp"
 
 namespace fc4sc
@@ -53,16 +59,434 @@ class cross_data_model : public cross_base_data_model {
 public:
 
   /*! Hit cross bins storage */
-  std::map<std::vector<size_t>, uint64_t> bins;
+  cross_bin_storage bins;
 
-  /*! Get cross bins storage */
-  virtual const std::map<std::vector<size_t>, uint64_t>& get_cross_bins() const
+  /*! Hit cross bins of shards 1 and up. Empty unless sampling is sharded */
+  std::vector<cross_bin_storage> shard_bins;
+
+  /*! User-defined bins, ignore bins and illegal bins */
+  std::vector<cross_bin> user_bins;
+
+  /*! Hit counters of the user-defined bins */
+  std::vector<counter_t> user_hits;
+
+  /*! Hit counters of the user-defined bins of shards 1 and up */
+  std::vector<std::vector<counter_t>> shard_user_hits;
+
+  /*! Bin masks of each user-defined bin, term and crossed coverpoint */
+  mutable std::vector<std::vector<std::vector<bin_mask>>> compiled_masks;
+
+  /*! Coverpoint sizes the user-defined bins were compiled for */
+  mutable std::vector<uint64_t> compiled_radix;
+
+  /*! Number of bins of the cross, counted when compiling */
+  mutable uint64_t compiled_total = 0;
+
+  /*!
+   * Indexes of the user-defined bins, illegal bins first, then ignore bins,
+   * then regular bins, in declaration order within each type
+   */
+  mutable std::vector<size_t> compiled_order;
+
+  /*! Position in compiled_order of the first regular bin */
+  mutable size_t compiled_defaults = 0;
+
+#ifdef FC4SC_ATOMIC_COUNTERS
+  /*! Serializes the insertion of new cross bins by concurrent samples */
+  mutable std::mutex bins_mutex;
+#endif
+
+  /*! Cross bins storage of a shard */
+  cross_bin_storage& bins_of(size_t shard)
+  {
+    return shard ? shard_bins[shard - 1] : bins;
+  }
+
+  /*!
+   * \brief Number of bins of each crossed coverpoint, at least enough to hold
+   * a tuple of bin indexes
+   * \param idx Tuple that must fit, or nullptr
+   */
+  std::vector<uint64_t> current_radix(const size_t* idx = nullptr) const
+  {
+    std::vector<uint64_t> radix(cross_cvps.size());
+    for (size_t k = 0; k < cross_cvps.size(); ++k) {
+      radix[k] = cross_cvps[k]->size();
+      if (idx && idx[k] >= radix[k]) radix[k] = idx[k] + 1;
+    }
+    return radix;
+  }
+
+  /*!
+   * \brief Adds hits to a cross bin in a shard, laying the storage out again
+   * if the crossed coverpoints got new bins
+   * \param shard Shard to count in
+   * \param idx Bin index of each crossed coverpoint
+   * \param n Number of hits
+   * \returns The new count of the cross bin in the shard
+   */
+  uint64_t add(size_t shard, const size_t* idx, uint64_t n = 1)
+  {
+    cross_bin_storage& storage = bins_of(shard);
+    if (!storage.fits(idx))
+      storage.reshape(current_radix(idx), option.dense_bins_max_bytes, option.bitmap_min_bins);
+    return storage.add(idx, n);
+  }
+
+  /*!
+   * \brief Lays out the storage of every shard for the current coverpoint
+   * sizes and compiles the user-defined bins for them
+   */
+  void layout_bins()
+  {
+    std::vector<uint64_t> radix = current_radix();
+    if (bins.radix != radix) bins.reshape(radix, option.dense_bins_max_bytes, option.bitmap_min_bins);
+    for (auto& shard : shard_bins)
+      if (shard.radix != radix) shard.reshape(radix, option.dense_bins_max_bytes, option.bitmap_min_bins);
+    if (!user_bins.empty() && compiled_radix != radix) compile_user_bins();
+  }
+
+  /*!
+   * \brief Finds the crossed coverpoint constrained by each condition of the
+   * user-defined bins. Called once the crossed coverpoints are known
+   */
+  void resolve_user_bins()
+  {
+    for (auto& bin : user_bins)
+      for (auto& term : bin.select.terms)
+        for (auto& cond : term) {
+          auto it = std::find(cross_cvps.begin(), cross_cvps.end(), cond.cvp);
+          if (it == cross_cvps.end()) {
+            std::cerr << "Cross bin " << bin.name << " of " << name
+                      << " selects bins of a coverpoint that is not crossed\n";
+            throw(std::string("Cross bin " + bin.name + " of " + name +
+                              " selects bins of a coverpoint that is not crossed"));
+          }
+          cond.position = it - cross_cvps.begin();
+        }
+    user_hits.assign(user_bins.size(), 0);
+    for (auto& shard : shard_user_hits)
+      shard.assign(user_bins.size(), 0);
+    compiled_radix.clear();
+  }
+
+  /*!
+   * \brief Compiles the user-defined bins to one bin mask per term and
+   * crossed coverpoint, and counts the cross bins left to the automatic bins
+   */
+  void compile_user_bins() const
+  {
+    compiled_radix = current_radix();
+    const size_t n = cross_cvps.size();
+    std::vector<const std::vector<bin_mask>*> all_terms;
+    compiled_masks.assign(user_bins.size(), std::vector<std::vector<bin_mask>>());
+    for (size_t b = 0; b < user_bins.size(); ++b) {
+      auto& terms = user_bins[b].select.terms;
+      compiled_masks[b].assign(terms.size(), std::vector<bin_mask>(n));
+      for (size_t t = 0; t < terms.size(); ++t) {
+        std::vector<bin_mask>& masks = compiled_masks[b][t];
+        for (size_t k = 0; k < n; ++k)
+          masks[k].assign((compiled_radix[k] + 63) / 64, ~uint64_t(0));
+        bin_mask cond_mask;
+        for (auto& cond : terms[t]) {
+          cond.select(static_cast<const coverpoint_base_data_model*>(cross_cvps[cond.position]), cond_mask);
+          bin_mask& mask = masks[cond.position];
+          for (size_t w = 0; w < mask.size(); ++w)
+            mask[w] &= (w < cond_mask.size()) ? cond_mask[w] : 0;
+        }
+        all_terms.push_back(&masks);
+      }
+    }
+
+    uint64_t total = 1;
+    for (auto r : compiled_radix) total *= r;
+    compiled_total = total - count_union(all_terms, 0);
+    for (auto& bin : user_bins)
+      compiled_total += (bin.type == default_);
+
+    compiled_order.clear();
+    for (bin_t type : { illegal_, ignore_, default_ }) {
+      if (type == default_) compiled_defaults = compiled_order.size();
+      for (size_t b = 0; b < user_bins.size(); ++b)
+        if (user_bins[b].type == type) compiled_order.push_back(b);
+    }
+  }
+
+  /*!
+   * \brief Counts the cross bins selected by at least one of the terms,
+   * from coverpoint k onwards. Groups the bins of coverpoint k by the terms
+   * selecting them, so each group is only counted once
+   * \param terms Bin masks of each term
+   * \param k Position of the first coverpoint to count
+   */
+  uint64_t count_union(const std::vector<const std::vector<bin_mask>*>& terms, size_t k) const
+  {
+    if (terms.empty()) return 0;
+    if (k == compiled_radix.size()) return 1;
+    std::map<std::vector<size_t>, uint64_t> groups;
+    std::vector<size_t> selecting;
+    for (size_t i = 0; i < compiled_radix[k]; ++i) {
+      selecting.clear();
+      for (size_t t = 0; t < terms.size(); ++t)
+        if (((*terms[t])[k][i / 64] >> (i % 64)) & 1) selecting.push_back(t);
+      if (!selecting.empty()) groups[selecting]++;
+    }
+    uint64_t total = 0;
+    std::vector<const std::vector<bin_mask>*> group_terms;
+    for (auto& group : groups) {
+      group_terms.clear();
+      for (auto t : group.first) group_terms.push_back(terms[t]);
+      total += group.second * count_union(group_terms, k + 1);
+    }
+    return total;
+  }
+
+  /*! Hit counters of the user-defined bins of a shard */
+  std::vector<counter_t>& user_hits_of(size_t shard)
+  {
+    return shard ? shard_user_hits[shard - 1] : user_hits;
+  }
+
+  /*! Cross bin hit, handed to format_cross_bin() */
+  struct cross_bin_value {
+    const size_t* idx;
+    size_t n;
+  };
+
+  /*! Formats a cross bin hit as the tuple of its bin indexes */
+  static std::string format_cross_bin(const void* value)
+  {
+    const cross_bin_value& bin = *static_cast<const cross_bin_value*>(value);
+    std::stringstream ss;
+    ss << "(";
+    for (size_t k = 0; k < bin.n; ++k)
+      ss << (k ? "," : "") << bin.idx[k];
+    ss << ")";
+    return ss.str();
+  }
+
+  /*!
+   * \brief Counts a sampled cross bin in the user-defined bins selecting it.
+   * Illegal bins take precedence over ignore bins, which take precedence
+   * over regular bins
+   * \param shard Shard to count in
+   * \param idx Bin index of each crossed coverpoint
+   * \param cvg_name Name of the covergroup sampling, for illegal bin hits
+   * \returns True if a user-defined bin selects the cross bin, so it is not
+   * counted in the automatic bins
+   */
+  bool sample_user_bins(size_t shard, const size_t* idx, const std::string* cvg_name)
+  {
+    if (!compiled_for(idx)) {
+#ifdef FC4SC_ATOMIC_COUNTERS
+      std::lock_guard<std::mutex> lock(bins_mutex);
+      if (!compiled_for(idx))
+#endif
+      compile_user_bins();
+    }
+
+    // one pass in order of precedence, stopping before the regular bins
+    // once an ignore bin is hit
+    bool ignored = false, selected = false;
+    std::vector<counter_t>& hits = user_hits_of(shard);
+    for (size_t i = 0; i < compiled_order.size(); ++i) {
+      if (i == compiled_defaults && ignored) break;
+      size_t b = compiled_order[i];
+      if (!selects(b, idx)) continue;
+      uint64_t count = count_hit(hits[b]);
+      switch (user_bins[b].type) {
+      case illegal_: {
+        cross_bin_value value = { idx, cross_cvps.size() };
+        handle_illegal_hit(illegal_bin_hit(cvg_name, name, user_bins[b].name, &value, &format_cross_bin));
+        return true;
+      }
+      case ignore_:
+        ignored = true;
+        break;
+      default:
+        selected = true;
+        if (!sharded() && count == std::max<uint64_t>(covered_at_least, 1))
+          bin_covered();
+      }
+    }
+    if (ignored) {
+      shard_miss(shard)++;
+      return true;
+    }
+    return selected;
+  }
+
+  /*!
+   * \brief Checks if the user-defined bins were compiled for coverpoint
+   * sizes holding a cross bin
+   * \param idx Bin index of each crossed coverpoint
+   */
+  bool compiled_for(const size_t* idx) const
+  {
+    if (compiled_radix.size() != cross_cvps.size()) return false;
+    for (size_t k = 0; k < compiled_radix.size(); ++k)
+      if (idx[k] >= compiled_radix[k]) return false;
+    return true;
+  }
+
+  /*!
+   * \brief Checks if a user-defined bin selects a cross bin, using the
+   * compiled masks
+   * \param b Index of the user-defined bin
+   * \param idx Bin index of each crossed coverpoint
+   */
+  bool selects(size_t b, const size_t* idx) const
+  {
+    for (auto& masks : compiled_masks[b]) {
+      bool all = true;
+      for (size_t k = 0; all && k < masks.size(); ++k)
+        all = (masks[k][idx[k] / 64] >> (idx[k] % 64)) & 1;
+      if (all) return true;
+    }
+    return false;
+  }
+
+  /*!
+   * \class missing_iterator
+   * \brief Streams the cross bins hit fewer than option.at_least times
+   *
+   * Walks the bin index tuples in key order, the last index varying fastest,
+   * and stops on each one that is not covered. Each tuple is looked up in
+   * the storage of every shard, so the iteration needs no memory besides the
+   * current tuple, however large the cross. Tuples selected by user-defined
+   * bins are skipped, as they are counted by those bins instead.
+   */
+  class missing_iterator
+  {
+    const cross_data_model* crs;
+    std::vector<uint64_t> radix;
+    std::vector<size_t> idx;
+    uint64_t threshold;
+    bool at_end;
+
+    /*! Moves to the next tuple, returns false past the last one */
+    bool step()
+    {
+      for (size_t k = idx.size(); k-- > 0; ) {
+        if (++idx[k] < radix[k]) return true;
+        idx[k] = 0;
+      }
+      return false;
+    }
+
+    bool missing() const
+    {
+      if (!crs->user_bins.empty())
+        for (size_t b = 0; b < crs->user_bins.size(); ++b)
+          if (crs->selects(b, idx.data())) return false;
+      uint64_t hits = crs->bins.count(idx.data());
+      for (auto& shard : crs->shard_bins)
+        hits += shard.count(idx.data());
+      return hits < threshold;
+    }
+
+  public:
+
+    explicit missing_iterator(const cross_data_model& crs) :
+      crs(&crs), radix(crs.current_radix()), idx(radix.size(), 0),
+      threshold(std::max<uint64_t>(crs.option.at_least, 1)), at_end(radix.empty())
+    {
+      for (auto r : radix) at_end |= (r == 0);
+      if (!crs.user_bins.empty() && crs.compiled_radix != radix) crs.compile_user_bins();
+      if (!at_end && !missing()) ++*this;
+    }
+
+    /*! True once every missing bin was visited */
+    bool done() const
+    {
+      return at_end;
+    }
+
+    /*! Bin index of each crossed coverpoint of the current missing bin */
+    const std::vector<size_t>& operator*() const
+    {
+      return idx;
+    }
+
+    /*! Moves to the next missing bin */
+    missing_iterator& operator++()
+    {
+      while (!at_end) {
+        at_end = !step();
+        if (!at_end && missing()) break;
+      }
+      return *this;
+    }
+  };
+
+  std::vector<std::vector<size_t>> get_missing_bins(size_t max) const
+  {
+    std::vector<std::vector<size_t>> result;
+    for (missing_iterator it(*this); !it.done() && result.size() < max; ++it)
+      result.push_back(*it);
+    return result;
+  }
+
+  /*!
+   * \brief Prints the cross bins hit fewer than option.at_least times, one
+   * per line, as the names of their coverpoint bins
+   * \param os Where to print
+   * \param max Maximum number of bins printed
+   */
+  void print_missing(std::ostream& os, size_t max) const
+  {
+    os << "Missing bins of cross " << name << ":\n";
+    size_t printed = 0;
+    for (missing_iterator it(*this); !it.done() && printed < max; ++it, ++printed) {
+      os << "  ";
+      for (size_t k = 0; k < cross_cvps.size(); ++k) {
+        auto cvp = static_cast<coverpoint_base_data_model*>(cross_cvps[k]);
+        os << (k ? " x " : "") << cvp->name << "." << cvp->declared_bins()[(*it)[k]]->get_name();
+      }
+      os << "\n";
+    }
+  }
+
+  std::vector<cross_bin_hits> get_user_bins() const
   {
-    return bins;
+    std::vector<cross_bin_hits> result;
+    for (size_t b = 0; b < user_bins.size(); ++b) {
+      uint64_t hits = user_hits[b];
+      for (auto& shard : shard_user_hits)
+        hits += shard[b];
+      result.push_back(cross_bin_hits{ user_bins[b].name, user_bins[b].type, hits });
+    }
+    return result;
+  }
+
+  virtual void for_each_cross_bin(const std::function<void(const size_t*, uint64_t)>& f) const
+  {
+    if (shard_bins.empty()) {
+      bins.for_each([&f](const size_t* idx, uint64_t count) { f(idx, count); });
+      return;
+    }
+    // A bin may be hit in several shards, its counts are added up first
+    std::map<std::vector<size_t>, uint64_t> merged;
+    auto merge = [this, &merged](const size_t* idx, uint64_t count) {
+      merged[std::vector<size_t>(idx, idx + cross_cvps.size())] += count;
+    };
+    bins.for_each(merge);
+    for (auto& shard : shard_bins)
+      shard.for_each(merge);
+    for (auto& it : merged)
+      f(it.first.data(), it.second);
   }
 
+  /*!
+   * \brief Number of bins of the cross: the combinations not selected by any
+   * user-defined bin, plus the user-defined regular bins
+   */
   uint64_t size() const
   {
+    if (!user_bins.empty()) {
+      if (compiled_radix != current_radix()) compile_user_bins();
+      return compiled_total;
+    }
     uint64_t total = 1;
     for (auto& cvp : cross_cvps) 
     {
@@ -79,15 +503,16 @@ public:
 };
 
 /*!
- * \brief Defines a class for crosses
- * \tparam Args Type of coverpoints being crossed
+ * \brief Cross of any number of coverpoints of any types, chosen at runtime.
+ * Used by dynamic covergroups and as the base of the typed crosses
  */
-template <typename... Args>
-class cross : public cross_base
+class dynamic_cross : public cross_base
 {
 
   friend class dynamic_covergroup_factory;
 
+protected:
+
   /*! Pointer to this object's data */
   cross_data_model* crs_data = new cross_data_model;
 
@@ -101,103 +526,129 @@ class cross : public cross_base
   uint64_t total_coverpoints = 0;
 
   /*!
-   *  \brief Create a dynamic copy of this cross with same type definition
+   *  \brief Sets the crossed coverpoints. Cross bins list their bin indexes
+   *  in the reverse order of the coverpoints
+   *  \param cvps Coverpoints to be crossed, in declaration order
    */
-  cvp_base* create_instance(cvg_base* cvg_inst)
+  void set_coverpoints(const std::vector<cvp_base*>& cvps)
   {
-    cross<Args...>* crs = new cross<Args...>;
-    crs->total_coverpoints = this->total_coverpoints;
-    crs->crs_data->name = this->crs_data->name;
-    for (auto cvp : this->cvps_vec)
-    {
-      crs->cvps_vec.push_back(&(cvg_inst->get_coverpoint(cvp->name())));
-      crs->crs_data->cross_cvps.push_back(cvg_inst->get_coverpoint(cvp->name()).get_data());
+    total_coverpoints = 1;
+    for (auto cvp : cvps)
+      total_coverpoints *= cvp->size();
+    cvps_vec.assign(cvps.rbegin(), cvps.rend());
+    for(auto cvp_it : cvps_vec) {
+      crs_data->cross_cvps.push_back(cvp_it->get_data());
     }
-    return crs;
+    crs_data->resolve_user_bins();
   }
 
   /*!
-   * \brief Helper function to recursively determine number of bins in a cross
-   * \tparam Head Type of current processed coverpoint
-   * \tparam Tail Rest of coverpoints
-   * \param h Current coverpoint
-   * \param t Rest of coverpoints
-   * \returns number of bins in this cross
+   *  \brief Copies the definition of this cross to a cross of a dynamic
+   *  covergroup instance, crossing the coverpoints of the instance
    */
-  template <typename Head, typename... Tail>
-  int get_size(Head h, Tail... t)
+  void copy_definition(dynamic_cross* crs, cvg_base* cvg_inst)
   {
-    return h->size() * get_size(t...);
+    crs->total_coverpoints = this->total_coverpoints;
+    crs->crs_data->name = this->crs_data->name;
+    for (auto cvp : this->cvps_vec)
+    {
+      cvp_base& inst_cvp = cvg_inst->get_coverpoint(cvp->name());
+      crs->cvps_vec.push_back(&inst_cvp);
+      crs->crs_data->cross_cvps.push_back(inst_cvp.get_data());
+    }
+    // conditions refer to the coverpoints of this instance by position
+    crs->crs_data->user_bins = this->crs_data->user_bins;
+    for (auto& bin : crs->crs_data->user_bins)
+      for (auto& term : bin.select.terms)
+        for (auto& cond : term)
+          cond.cvp = crs->crs_data->cross_cvps[cond.position];
+    crs->crs_data->resolve_user_bins();
   }
 
   /*!
-   * \brief End of recursion
-   * \returns Default value 1
+   *  \brief Create a dynamic copy of this cross with same type definition
    */
-  int get_size()
+  virtual cvp_base* create_instance(cvg_base* cvg_inst)
   {
-    return 1;
+    dynamic_cross* crs = new dynamic_cross;
+    copy_definition(crs, cvg_inst);
+    return crs;
   }
 
   /*!
-   *  \brief Helper function to check if a sampled value is in a cross
-   *  \tparam k Index of the currently checked element
-   *  \tparam Head Type of current processed value
-   *  \tparam Tail Rest of sampled values
-   *  \param found Storage of hit bins for each coverpoint
-   *  \param h Current sample value checked
-   *  \param t Rest of sample values
-   *  \returns True if each value is in its corresponding coverpoint
+   *  \brief Counts one hit combination of bins
+   *  \param shard Shard to count in
+   *  \param hit_bins Bin index of each crossed coverpoint
    */
-  template <size_t k, typename Head, typename... Tail>
-  bool check(std::vector<std::vector<size_t>> &found, Head h, Tail... t)
+  void sample_bin(size_t shard, const size_t* hit_bins)
   {
-
-    // See if the current value is in its coverpoint, and where
-    std::vector<size_t> bin_indexes = (static_cast<coverpoint<Head> *>(cvps_vec[k - 1]))->get_bin_index(h);
-
-    // If atleast one bin has it
-    bool found_in_cvp = bin_indexes.size() > 0;
-
-    if (!found_in_cvp)
-    {
-      return false;
+    if (!crs_data->user_bins.empty() && crs_data->sample_user_bins(shard, hit_bins, this->cvg_name))
+      return;
+    uint64_t count;
+    if (counter_t* counter = crs_data->bins_of(shard).find_dense(hit_bins)) {
+      count = count_hit(*counter);
+    }
+    else {
+#ifdef FC4SC_ATOMIC_COUNTERS
+      std::lock_guard<std::mutex> lock(crs_data->bins_mutex);
+#endif
+      count = crs_data->add(shard, hit_bins);
+    }
+    if (!crs_data->sharded()) {
+      // with at_least 0 every hit cross bin is covered, counted on its first hit
+      uint64_t threshold = std::max<uint64_t>(crs_data->covered_at_least, 1);
+      if (count == threshold) crs_data->bin_covered();
     }
-
-    // Store bins for this coverpoint
-    found.push_back(bin_indexes);
-
-    // Recurse
-    return (k == 1) ? (found_in_cvp) : (check<k - 1>(found, t...) && (found_in_cvp));
-  }
-
-  /*!
-   * \brief End of recursion
-   */
-  template <size_t k>
-  bool check(std::vector<std::vector<size_t>> &found) {
-    (void)found; // safe warning suppression
-    return true;
   }
 
   /*!
-   *  \brief Private constructor used by dynamic_covergroups
-   *  \param cross name
-   *  \param args Coverpoints to be crossed
+   *  \brief Counts every combination of the bins hit by the crossed
+   *  coverpoints, which is more than one when a value hits overlapping bins.
+   *  At most option.max_hit_combinations combinations are counted per sample,
+   *  the samples going past it are counted in truncated_samples
+   *  \param shard Shard to count in
+   *  \param hits Receives the bins hit by each crossed coverpoint
+   *  \param pos Receives the position of the combination in each list
+   *  \param hit_bins Receives the bin index of each crossed coverpoint
    */
-  template <typename... Restrictions>
-  cross(const std::string& name, coverpoint<Args> *... args, Restrictions... binsofs) : cross(binsofs...) 
+  void sample_hits(size_t shard, const bin_hit_list** hits, size_t* pos, size_t* hit_bins)
   {
-    this->crs_data->name = name;
-
-    total_coverpoints = get_size(args...);
-    cvps_vec = std::vector<cvp_base*>{args...};
+    const size_t n = cvps_vec.size();
+    for (size_t k = 0; k < n; ++k) {
+      cvp_base* cvp = cvps_vec[k];
+      hits[k] = &cvp->bins_hit(shard);
+      if (!cvp->sample_success(shard) || hits[k]->empty()) {
+        crs_data->shard_miss(shard)++;
+        return;
+      }
+      pos[k] = 0;
+      hit_bins[k] = (*hits[k])[0];
+    }
 
-    std::reverse(cvps_vec.begin(), cvps_vec.end());
-    for(auto cvp_it : cvps_vec) {
-      crs_data->cross_cvps.push_back(cvp_it->get_data());
+    const uint64_t max_combinations = std::max<uint64_t>(crs_data->option.max_hit_combinations, 1);
+    for (uint64_t combinations = 1; ; ++combinations) {
+      sample_bin(shard, hit_bins);
+      if (combinations == max_combinations) {
+        for (size_t k = 0; k < n; ++k)
+          if (pos[k] + 1 < hits[k]->size()) {
+            crs_data->sample_truncated("hit more than option.max_hit_combinations bins in one sample, the others are not counted");
+            break;
+          }
+        return;
+      }
+      // next combination, the first coverpoint varying fastest
+      size_t k = 0;
+      for (; k < n; ++k) {
+        if (++pos[k] < hits[k]->size()) {
+          hit_bins[k] = (*hits[k])[pos[k]];
+          break;
+        }
+        pos[k] = 0;
+        hit_bins[k] = (*hits[k])[0];
+      }
+      if (k == n) return;
     }
-  };
+  }
 
 public:
 
@@ -205,64 +656,58 @@ public:
   std::vector<cvp_base *> cvps_vec;
 
   /*!
-   *  \brief Main constructor
-   *  \param n Parent covergroup
-   *  \param args Coverpoints to be crossed
+   *  \brief Constructor of a cross whose coverpoints are only known at runtime
+   *  \param name Cross name
+   *  \param cvps Coverpoints to be crossed
    */
-  template <typename... Restrictions>
-  cross(cvg_base *n, coverpoint<Args> *... args, Restrictions... binsofs) : cross(binsofs...) 
+  dynamic_cross(const std::string& name, const std::vector<cvp_base*>& cvps)
   {
-    n->cvps.push_back(this);
-    n->get_cvg_data()->add_cvp_data(crs_data);
-
-    total_coverpoints = get_size(args...);
-    cvps_vec = std::vector<cvp_base*>{args...};
-
-    std::reverse(cvps_vec.begin(), cvps_vec.end());
-    for(auto cvp_it : cvps_vec) {
-      crs_data->cross_cvps.push_back(cvp_it->get_data());
-    }
-  };
-
-  
-  template <typename... Restrictions, typename Select>
-  cross(binsof<Select> binsof_inst,  Restrictions... binsofs) : cross (binsofs...) {
-    std::cerr << "consume binsof\n";
-    static_cast<void>(binsof_inst);
-  }
-
-  cross(cvg_base *n, const std::string& name, coverpoint<Args> *... args) : cross(n, args...) {
     this->crs_data->name = name;
-  };
-
+    set_coverpoints(cvps);
+  }
 
   /*!
    *  \brief Default constructor
    */
-  cross(){}
+  dynamic_cross(){}
+
+  ~dynamic_cross()
+  {
+    this->stop_async_worker();
+  }
+
+  /*! Crosses read no value, they count the results of their coverpoints */
+  bool can_capture() const
+  {
+    return true;
+  }
 
   /*!
    *  \brief Sampling function at cross level
+   *
+   *  The scratch arrays live on the stack up to inline_arity crossed
+   *  coverpoints, so sampling does not allocate.
    */
   virtual void sample() 
   {
-    if(valid_data.use_count() == 0) {
-      std::cerr << "Error: coverage data has been deleted\n";
-      throw("Error: coverage data has been deleted");
-    }
+    FC4SC_CHECK_MEMBER_SAMPLE(valid_data);
 
     if (!this->collect) return;
-    std::vector <size_t> hit_bins;
-    for (auto& cvp : cvps_vec) {
-      if (cvp->last_sample_success) {
-        hit_bins.push_back(cvp->last_bin_index_hit);
-      }
-      else {
-        crs_data->misses++;
-        return;
-      }
+    size_t shard = this->current_shard();
+    const size_t inline_arity = 8;
+    const size_t n = cvps_vec.size();
+    if (n <= inline_arity) {
+      const bin_hit_list* hits[inline_arity];
+      size_t pos[inline_arity];
+      size_t hit_bins[inline_arity];
+      sample_hits(shard, hits, pos, hit_bins);
+    }
+    else {
+      std::vector<const bin_hit_list*> hits(n);
+      std::vector<size_t> pos(n);
+      std::vector<size_t> hit_bins(n);
+      sample_hits(shard, hits.data(), pos.data(), hit_bins.data());
     }
-    crs_data->bins[hit_bins]++;
   }
 
   /*!
@@ -276,18 +721,12 @@ public:
       throw("Error: coverage data has been deleted");
     }
 
-    int covered = 0;
-    //int total = total_coverpoints;
-    int total = this->size();
+    uint64_t total = this->size();
 
     if (total == 0)
       return (this->crs_data->option.weight == 0) ? 100 : 0;
 
-    for (auto it : crs_data->bins)
-    {
-      if (it.second >= crs_data->option.at_least)
-        covered++;
-    }
+    uint64_t covered = crs_data->get_covered_bins();
 
     double real = 100.0 * covered / total;
     return (real >= this->crs_data->option.goal) ? 100 : real;
@@ -299,29 +738,26 @@ public:
    *  \param total Total number of bins in this cross
    *  \returns Coverage value as a double between 0 and 100
    */
-  double get_inst_coverage(int &covered, int &total) const 
+  double get_inst_coverage(uint64_t &covered, uint64_t &total) const 
   {
     if(valid_data.use_count() == 0) {
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
 
-    //total = total_coverpoints;
     total = this->size();
-    covered = 0;
-
-    for (auto it : crs_data->bins)
-    {
-      if (it.second >= crs_data->option.at_least)
-        covered++;
-    }
+    covered = crs_data->get_covered_bins();
 
     if (total == 0)
       return (this->crs_data->option.weight == 0) ? 100 : 0;
 
-    return covered / total;
+    double real = 100.0 * covered / total;
+    return (real >= this->crs_data->option.goal) ? 100 : real;
   }
 
+  /*! int version of get_inst_coverage(uint64_t&, uint64_t&) */
+  using api_base::get_inst_coverage;
+
   cvp_base_data_model* get_data()
   {
     if(valid_data.use_count() == 0) {
@@ -385,7 +821,62 @@ public:
       throw("Error: coverage data has been deleted");
     }
 
-    return crs_data->misses;
+    return crs_data->total_misses();
+  }
+
+  /*!
+   *  \brief Sets the number of shards sampled into. Counts of removed shards
+   *  are added to shard 0. The crossed coverpoints must have at least as
+   *  many shards
+   *  \param shards Number of shards, 1 disables sharding
+   */
+  void set_shards(size_t shards)
+  {
+    if (shards == 0) shards = 1;
+    for (size_t s = shards; s < this->shard_states.size() + 1; ++s) {
+      crs_data->shard_bins[s - 1].for_each([this](const size_t* idx, uint64_t count) {
+        crs_data->add(0, idx, count);
+      });
+      crs_data->misses += crs_data->shard_misses[s - 1].value;
+      for (size_t b = 0; b < crs_data->user_bins.size(); ++b)
+        crs_data->user_hits[b] += crs_data->shard_user_hits[s - 1][b];
+    }
+    this->shard_states.resize(shards - 1);
+    crs_data->shard_misses.resize(shards - 1);
+    crs_data->shard_bins.resize(shards - 1);
+    crs_data->shard_user_hits.resize(shards - 1);
+    for (auto& shard : crs_data->shard_user_hits)
+      shard.resize(crs_data->user_bins.size(), 0);
+    crs_data->layout_bins();
+    crs_data->covered_valid = false;
+    crs_data->coverage_changed();
+  }
+
+  /*!
+   * \brief Lays out the cross bin storage for the current coverpoint sizes
+   */
+  void prepare_sample()
+  {
+    crs_data->layout_bins();
+    crs_data->stop_at_goal = crs_data->option.stop_at_goal;
+    crs_data->at_goal_sample_period = crs_data->option.at_goal_sample_period;
+    // the covered bins are then counted while sampling
+    if (crs_data->stop_at_goal) crs_data->get_covered_bins();
+  }
+
+  /*! Samples a group of runtime crosses without virtual calls */
+  static void sample_group_of(cvp_base* const* cvps, size_t n, size_t& next)
+  {
+    for (; next < n; ++next)
+      static_cast<dynamic_cross*>(cvps[next])->dynamic_cross::sample();
+  }
+
+  /*! Derived types keep the virtual call unless they provide their own */
+  sample_group_fn sample_group() const
+  {
+    if (typeid(*this) != typeid(dynamic_cross))
+      return &cvp_base::sample_group_virtual;
+    return &dynamic_cross::sample_group_of;
   }
 
   /*!
@@ -408,24 +899,29 @@ public:
       throw("Error: coverage data has been deleted");
     }
 
-    uint64_t total = 1;
-    for (auto& cvp : cvps_vec) 
-    {
-      total *= cvp->size();
-    }
-    return total;
-    //return total_coverpoints;
+    return crs_data->size();
   };
 
-  /*! Get cross bins storage */
-  const std::map<std::vector<size_t>, uint64_t>& get_cross_bins() const
+  /*! Get a copy of the hit cross bins, built from the counters on every call */
+  std::map<std::vector<size_t>, uint64_t> get_cross_bins() const
+  {
+    if(valid_data.use_count() == 0) {
+      std::cerr << "Error: coverage data has been deleted\n";
+      throw("Error: coverage data has been deleted");
+    }
+
+    return crs_data->get_cross_bins();
+  }
+
+  /*! Calls f(idx, count) once for every cross bin hit */
+  void for_each_cross_bin(const std::function<void(const size_t*, uint64_t)>& f) const
   {
     if(valid_data.use_count() == 0) {
       std::cerr << "Error: coverage data has been deleted\n";
       throw("Error: coverage data has been deleted");
     }
 
-    return crs_data->bins;
+    crs_data->for_each_cross_bin(f);
   }
 
   /*! Get crossed coverpoints storage */
@@ -439,6 +935,142 @@ public:
     return cvps_vec;
   }
 
+  /*!
+   * \brief Lists the cross bins hit fewer than option().at_least times, as
+   * tuples of bin indexes in the order of get_cross_bins()
+   * \param max Maximum number of bins listed
+   */
+  std::vector<std::vector<size_t>> get_missing_bins(size_t max) const
+  {
+    if(valid_data.use_count() == 0) {
+      std::cerr << "Error: coverage data has been deleted\n";
+      throw("Error: coverage data has been deleted");
+    }
+
+    return crs_data->get_missing_bins(max);
+  }
+
+  /*!
+   * \brief Prints the first option().cross_num_print_missing cross bins hit
+   * fewer than option().at_least times
+   * \param os Where to print
+   */
+  void print_missing(std::ostream& os = std::cout) const
+  {
+    if(valid_data.use_count() == 0) {
+      std::cerr << "Error: coverage data has been deleted\n";
+      throw("Error: coverage data has been deleted");
+    }
+
+    crs_data->print_missing(os, crs_data->option.cross_num_print_missing);
+  }
+
+};
+
+/*!
+ * \brief Defines a class for crosses
+ * \tparam Args Type of coverpoints being crossed
+ */
+template <typename... Args>
+class cross : public dynamic_cross
+{
+
+  friend class dynamic_covergroup_factory;
+
+  /*!
+   *  \brief Create a dynamic copy of this cross with same type definition
+   */
+  cvp_base* create_instance(cvg_base* cvg_inst)
+  {
+    cross<Args...>* crs = new cross<Args...>;
+    copy_definition(crs, cvg_inst);
+    return crs;
+  }
+
+  /*!
+   *  \brief Private constructor used by dynamic_covergroups
+   *  \param cross name
+   *  \param args Coverpoints to be crossed
+   */
+  template <typename... Restrictions>
+  cross(const std::string& name, coverpoint<Args> *... args, Restrictions... binsofs) : cross(binsofs...) 
+  {
+    this->crs_data->name = name;
+    set_coverpoints(std::vector<cvp_base*>{args...});
+  };
+
+public:
+
+  /*!
+   *  \brief Main constructor
+   *  \param n Parent covergroup
+   *  \param args Coverpoints to be crossed
+   *  \param binsofs User-defined cross bins (cross_bin, ignore_cross_bin,
+   *  illegal_cross_bin)
+   */
+  template <typename... Restrictions>
+  cross(cvg_base *n, coverpoint<Args> *... args, Restrictions... binsofs) : cross(binsofs...) 
+  {
+    n->cvps.push_back(this);
+    n->get_cvg_data()->add_cvp_data(crs_data);
+    set_coverpoints(std::vector<cvp_base*>{args...});
+  };
+
+  /*!
+   *  \brief Consumes the user-defined cross bins, in declaration order
+   *  \param bin First cross bin
+   *  \param binsofs Rest of cross bins
+   */
+  template <typename... Restrictions>
+  cross(const cross_bin& bin, Restrictions... binsofs) : cross(binsofs...) {
+    crs_data->user_bins.insert(crs_data->user_bins.begin(), bin);
+  }
+
+  template <typename... Restrictions>
+  cross(cvg_base *n, const std::string& name, coverpoint<Args> *... args, Restrictions... binsofs) : cross(n, args..., binsofs...) {
+    this->crs_data->name = name;
+  };
+
+
+  /*!
+   *  \brief Default constructor
+   */
+  cross(){}
+
+  ~cross()
+  {
+    this->stop_async_worker();
+  }
+
+  /*!
+   *  \brief Sampling function at cross level, with scratch arrays sized for
+   *  the crossed coverpoints
+   */
+  virtual void sample() 
+  {
+    FC4SC_CHECK_MEMBER_SAMPLE(valid_data);
+
+    if (!this->collect) return;
+    std::array<const bin_hit_list*, sizeof...(Args)> hits;
+    std::array<size_t, sizeof...(Args)> pos;
+    std::array<size_t, sizeof...(Args)> hit_bins;
+    sample_hits(this->current_shard(), hits.data(), pos.data(), hit_bins.data());
+  }
+
+  /*! Samples a group of crosses of this type without virtual calls */
+  static void sample_group_of(cvp_base* const* cvps, size_t n, size_t& next)
+  {
+    for (; next < n; ++next)
+      static_cast<cross*>(cvps[next])->cross::sample();
+  }
+
+  sample_group_fn sample_group() const
+  {
+    if (typeid(*this) != typeid(cross))
+      return &cvp_base::sample_group_virtual;
+    return &cross::sample_group_of;
+  }
+
 };
 
 } // namespace fc4sc
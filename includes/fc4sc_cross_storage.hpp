@@ -0,0 +1,451 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+
+/*!
+ \file fc4sc_cross_storage.hpp
+ \brief Hit counter storage of crosses
+
+   A cross bin is a combination of one bin of each crossed coverpoint. This
+ file contains the container counting the hits of each combination, used by
+ crosses when sampling.
+ */
+
+#ifndef FC4SC_CROSS_STORAGE_HPP
+#define FC4SC_CROSS_STORAGE_HPP
+
+#include <vector>
+#include <map>
+#include <cstddef>
+#include <stdint.h>
+#include <limits>
+#include <algorithm>
+
+#include "fc4sc_base.hpp"
+
+namespace fc4sc
+{
+
+/*!
+ * \class cross_bin_storage fc4sc_cross_storage.hpp
+ * \brief Hit counters of the bins of a cross
+ *
+ * A cross bin is identified by the tuple of bin indexes it combines. The
+ * storage linearizes the tuple to a single integer key, treating each index
+ * as a digit whose radix is the number of bins of its coverpoint. The layout
+ * is chosen from the number of possible keys:
+ *  - dense: one counter per possible key, indexed directly by the key
+ *  - hashed: an open-addressing hash table of the keys that were hit
+ *  - bitmap: for very large crosses, compressed bitmaps of the keys that
+ *    were hit, plus a hash table of the counts of keys hit more than once.
+ *    Keys sharing their high 48 bits are kept in one container, as a sorted
+ *    array of their low 16 bits while sparse and as a 65536-bit bitmap once
+ *    dense, so the memory used stays proportional to the number of keys hit
+ *  - tree: a map from tuple to counter, for crosses whose keys do not fit in
+ *    64 bits
+ *
+ * The radixes are fixed when the storage is laid out. A tuple with an index
+ * outside of its radix, e.g. after a bin was added to a crossed coverpoint,
+ * is rejected until the storage is laid out again with larger radixes.
+ */
+class cross_bin_storage
+{
+public:
+
+  /*! How the counters are stored */
+  enum layout_t
+  {
+    dense_layout,
+    hashed_layout,
+    bitmap_layout,
+    tree_layout
+  };
+
+  /*!
+   * \brief Hit keys sharing their high 48 bits (bitmap layout)
+   */
+  struct bitmap_container
+  {
+    /*! Number of keys above which the container switches to a bitmap */
+    static constexpr size_t array_max_size = 4096;
+
+    /*! Sorted low 16 bits of the keys, while sparse */
+    std::vector<uint16_t> array;
+
+    /*! One bit per low 16 bits, once dense */
+    std::vector<uint64_t> bits;
+
+    bool test(uint16_t low) const
+    {
+      if (!bits.empty()) return (bits[low / 64] >> (low % 64)) & 1;
+      return std::binary_search(array.begin(), array.end(), low);
+    }
+
+    /*! Adds a key, returns false if it was already present */
+    bool set(uint16_t low)
+    {
+      if (bits.empty()) {
+        auto it = std::lower_bound(array.begin(), array.end(), low);
+        if (it != array.end() && *it == low) return false;
+        if (array.size() < size_t(array_max_size)) {
+          array.insert(it, low);
+          return true;
+        }
+        bits.assign(65536 / 64, 0);
+        for (auto l : array) bits[l / 64] |= uint64_t(1) << (l % 64);
+        std::vector<uint16_t>().swap(array);
+      }
+      uint64_t& word = bits[low / 64];
+      const uint64_t bit = uint64_t(1) << (low % 64);
+      if (word & bit) return false;
+      word |= bit;
+      return true;
+    }
+
+    /*! Calls f(low) for every key, in increasing order */
+    template <typename F>
+    void for_each(F f) const
+    {
+      if (bits.empty()) {
+        for (auto l : array) f(l);
+        return;
+      }
+      for (size_t w = 0; w < bits.size(); ++w)
+        for (uint64_t word = bits[w], b = 0; word; word >>= 1, ++b)
+          if (word & 1) f(static_cast<uint16_t>(w * 64 + b));
+    }
+  };
+
+  /*! Key marking an empty slot of the hash table */
+  static constexpr uint64_t empty_key = std::numeric_limits<uint64_t>::max();
+
+  /*! Initial number of slots of the hash table */
+  static constexpr size_t initial_slots = 16;
+
+  /*! Number of bins of each crossed coverpoint the storage is laid out for */
+  std::vector<uint64_t> radix;
+
+  /*! Current layout */
+  layout_t layout = dense_layout;
+
+  /*! Counter of each key (dense layout) */
+  std::vector<counter_t> dense;
+
+  /*!
+   * Key of each slot of the hash table, empty_key if free (hashed layout, and
+   * bitmap layout for the keys hit more than once)
+   */
+  std::vector<uint64_t> slot_keys;
+
+  /*! Counter of each slot of the hash table */
+  std::vector<counter_t> slot_counts;
+
+  /*! Number of used slots of the hash table */
+  size_t slots_used = 0;
+
+  /*! Containers of the hit keys, by their high 48 bits (bitmap layout) */
+  std::map<uint64_t, bitmap_container> bitmap;
+
+  /*! Counter of each hit tuple (tree layout) */
+  std::map<std::vector<size_t>, counter_t> tree;
+
+  /*! Number of crossed coverpoints, 0 until laid out */
+  size_t arity() const
+  {
+    return radix.size();
+  }
+
+  /*!
+   * \brief Checks if every index of a tuple is within its radix
+   * \param idx Bin index of each crossed coverpoint
+   */
+  bool fits(const size_t* idx) const
+  {
+    if (radix.empty()) return false;
+    for (size_t k = 0; k < radix.size(); ++k)
+      if (idx[k] >= radix[k]) return false;
+    return true;
+  }
+
+  /*!
+   * \brief Linearizes a tuple, the first index being the most significant
+   * \param idx Bin index of each crossed coverpoint, which must fit
+   */
+  uint64_t key_of(const size_t* idx) const
+  {
+    uint64_t key = 0;
+    for (size_t k = 0; k < radix.size(); ++k)
+      key = key * radix[k] + idx[k];
+    return key;
+  }
+
+  /*!
+   * \brief Recovers the tuple of a linearized key
+   * \param key Linearized key
+   * \param idx Receives the bin index of each crossed coverpoint
+   */
+  void tuple_of(uint64_t key, size_t* idx) const
+  {
+    for (size_t k = radix.size(); k-- > 0; ) {
+      idx[k] = key % radix[k];
+      key /= radix[k];
+    }
+  }
+
+  /*!
+   * \brief Lays the storage out for new radixes, keeping all counts
+   * \param new_radix Number of bins of each crossed coverpoint. Must not be
+   * smaller than any index counted so far
+   * \param dense_max_bytes Memory limit for the dense layout
+   * \param bitmap_min_keys Number of possible keys from which the bitmap
+   * layout is used instead of the hashed layout
+   */
+  void reshape(const std::vector<uint64_t>& new_radix, size_t dense_max_bytes,
+               uint64_t bitmap_min_keys = std::numeric_limits<uint64_t>::max())
+  {
+    std::vector<size_t> tuples;
+    std::vector<uint64_t> counts;
+    for_each([&](const size_t* idx, uint64_t count) {
+      tuples.insert(tuples.end(), idx, idx + arity());
+      counts.push_back(count);
+    });
+    size_t old_arity = arity();
+
+    radix = new_radix;
+    dense.clear();
+    slot_keys.clear();
+    slot_counts.clear();
+    slots_used = 0;
+    bitmap.clear();
+    tree.clear();
+
+    // number of possible keys, saturating when it does not fit in 64 bits
+    uint64_t keys = 1;
+    bool overflow = false;
+    for (auto r : radix) {
+      if (r == 0) { keys = 0; break; }
+      if (keys > (empty_key - 1) / r) overflow = true;
+      else keys *= r;
+    }
+
+    if (overflow) {
+      layout = tree_layout;
+    }
+    else if (keys <= dense_max_bytes / sizeof(counter_t)) {
+      layout = dense_layout;
+      dense.assign(keys, 0);
+    }
+    else {
+      layout = (keys >= bitmap_min_keys) ? bitmap_layout : hashed_layout;
+      slot_keys.assign(initial_slots, uint64_t(empty_key));
+      slot_counts.assign(initial_slots, 0);
+    }
+
+    for (size_t i = 0; old_arity && i < counts.size(); ++i)
+      add(&tuples[i * old_arity], counts[i]);
+  }
+
+  /*!
+   * \brief Returns the counter of a tuple if it is stored in the dense
+   * layout, without modifying the storage
+   * \param idx Bin index of each crossed coverpoint
+   * \returns Pointer to the counter, or nullptr
+   */
+  counter_t* find_dense(const size_t* idx)
+  {
+    if (layout != dense_layout || !fits(idx)) return nullptr;
+    return &dense[key_of(idx)];
+  }
+
+  /*!
+   * \brief Returns the hit count of a tuple, without modifying the storage
+   * \param idx Bin index of each crossed coverpoint
+   * \returns The count, 0 if the tuple was never hit
+   */
+  uint64_t count(const size_t* idx) const
+  {
+    if (!fits(idx)) return 0;
+    switch (layout) {
+    case dense_layout:
+      return dense[key_of(idx)];
+    case hashed_layout:
+      return slot_count(key_of(idx), 0);
+    case bitmap_layout: {
+      const uint64_t key = key_of(idx);
+      auto it = bitmap.find(key >> 16);
+      if (it == bitmap.end() || !it->second.test(static_cast<uint16_t>(key))) return 0;
+      return slot_count(key, 1);
+    }
+    default: {
+      auto it = tree.find(std::vector<size_t>(idx, idx + arity()));
+      return (it == tree.end()) ? 0 : static_cast<uint64_t>(it->second);
+    }
+    }
+  }
+
+  /*!
+   * \brief Returns the counter of a tuple, adding it if not present
+   * \param idx Bin index of each crossed coverpoint
+   * \returns Pointer to the counter, valid until the next insertion, or
+   * nullptr if the tuple does not fit the current radixes. Always nullptr in
+   * the bitmap layout, which has no counter for keys hit once: use add()
+   */
+  counter_t* insert(const size_t* idx)
+  {
+    if (!fits(idx)) return nullptr;
+    switch (layout) {
+    case dense_layout:
+      return &dense[key_of(idx)];
+    case hashed_layout:
+      return &slot_counts[find_slot(key_of(idx))];
+    case bitmap_layout:
+      return nullptr;
+    default:
+      return &tree[std::vector<size_t>(idx, idx + arity())];
+    }
+  }
+
+  /*!
+   * \brief Adds hits to a tuple, in any layout
+   * \param idx Bin index of each crossed coverpoint, which must fit
+   * \param n Number of hits
+   * \returns The new count of the tuple
+   */
+  uint64_t add(const size_t* idx, uint64_t n = 1)
+  {
+    if (layout != bitmap_layout) return count_hits(*insert(idx), n);
+    const uint64_t key = key_of(idx);
+    // only keys hit more than once have a counter in the table
+    if (bitmap[key >> 16].set(static_cast<uint16_t>(key))) {
+      if (n > 1) slot_counts[find_slot(key)] = n;
+      return n;
+    }
+    counter_t& count = slot_counts[find_slot(key)];
+    if (count == 0) count = 1;
+    return count_hits(count, n);
+  }
+
+  /*!
+   * \brief Calls f(idx, count) for every tuple hit at least once
+   * \param f Receives a pointer to the bin indexes and the hit count
+   */
+  template <typename F>
+  void for_each(F f) const
+  {
+    std::vector<size_t> idx(arity());
+    switch (layout) {
+    case dense_layout:
+      for (size_t key = 0; key < dense.size(); ++key) {
+        if (dense[key] == 0) continue;
+        tuple_of(key, idx.data());
+        f(static_cast<const size_t*>(idx.data()), static_cast<uint64_t>(dense[key]));
+      }
+      break;
+    case hashed_layout:
+      for (size_t i = 0; i < slot_keys.size(); ++i) {
+        if (slot_keys[i] == empty_key || slot_counts[i] == 0) continue;
+        tuple_of(slot_keys[i], idx.data());
+        f(static_cast<const size_t*>(idx.data()), static_cast<uint64_t>(slot_counts[i]));
+      }
+      break;
+    case bitmap_layout:
+      for (auto& container : bitmap) {
+        const uint64_t high = container.first << 16;
+        container.second.for_each([&](uint16_t low) {
+          tuple_of(high | low, idx.data());
+          f(static_cast<const size_t*>(idx.data()), slot_count(high | low, 1));
+        });
+      }
+      break;
+    default:
+      for (auto& it : tree)
+        if (it.second != 0) f(it.first.data(), static_cast<uint64_t>(it.second));
+    }
+  }
+
+  /*! Removes all counts and the layout */
+  void clear()
+  {
+    radix.clear();
+    layout = dense_layout;
+    dense.clear();
+    slot_keys.clear();
+    slot_counts.clear();
+    slots_used = 0;
+    bitmap.clear();
+    tree.clear();
+  }
+
+private:
+
+  /*!
+   * \brief Looks a key up in the hash table, without modifying it
+   * \param key Linearized key
+   * \param missing Count of a key not in the table
+   */
+  uint64_t slot_count(uint64_t key, uint64_t missing) const
+  {
+    const size_t mask = slot_keys.size() - 1;
+    for (size_t i = hash(key) & mask; slot_keys[i] != empty_key; i = (i + 1) & mask)
+      if (slot_keys[i] == key) return slot_counts[i];
+    return missing;
+  }
+
+  /*!
+   * \brief Finds the slot of a key in the hash table, claiming a free slot
+   * for it if not present. Grows the table above half occupancy
+   */
+  size_t find_slot(uint64_t key)
+  {
+    if ((slots_used + 1) * 2 > slot_keys.size()) grow();
+    const size_t mask = slot_keys.size() - 1;
+    size_t i = hash(key) & mask;
+    while (slot_keys[i] != key) {
+      if (slot_keys[i] == empty_key) {
+        slot_keys[i] = key;
+        ++slots_used;
+        break;
+      }
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  /*! Doubles the number of slots of the hash table */
+  void grow()
+  {
+    std::vector<uint64_t> old_keys(slot_keys.size() * 2, uint64_t(empty_key));
+    std::vector<counter_t> old_counts(slot_keys.size() * 2, 0);
+    old_keys.swap(slot_keys);
+    old_counts.swap(slot_counts);
+    slots_used = 0;
+    for (size_t i = 0; i < old_keys.size(); ++i)
+      if (old_keys[i] != empty_key) slot_counts[find_slot(old_keys[i])] = old_counts[i];
+  }
+
+  /*! Mixes the bits of a key so that consecutive keys spread over the table */
+  static size_t hash(uint64_t key)
+  {
+    key *= 0x9e3779b97f4a7c15ull;
+    return static_cast<size_t>(key ^ (key >> 32));
+  }
+
+};
+
+} // namespace fc4sc
+
+#endif /* FC4SC_CROSS_STORAGE_HPP */
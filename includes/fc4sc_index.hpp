@@ -0,0 +1,339 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+
+/*!
+ \file fc4sc_index.hpp
+ \brief Compiled lookup index used by coverpoints when sampling
+
+   The interval maps of a coverpoint are convenient to build incrementally but
+ slow to search. This file contains the flat representation the maps are
+ compiled into before sampling.
+ */
+
+#ifndef FC4SC_INDEX_HPP
+#define FC4SC_INDEX_HPP
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <stdint.h>
+#include <type_traits>
+#include <algorithm>
+#include <limits>
+
+#include "fc4sc_base.hpp"
+
+namespace fc4sc
+{
+
+/*!
+ * \class interval_index fc4sc_index.hpp
+ * \brief Flat, sorted array representation of a coverpoint interval map
+ * \tparam T Type of the sampled values
+ *
+ * Each entry of the index is a disjoint value range together with the list of
+ * (bin, interval) pairs that contain it. The ranges are kept in contiguous
+ * arrays sorted by their upper bound, so a lookup is a branchless binary
+ * search over a single array instead of a walk through a red-black tree.
+ *
+ * The ignore, illegal and regular interval maps of a coverpoint are merged
+ * into a single index. Every bin reference is tagged with the type of its bin
+ * and the references of a range are ordered ignore, illegal then regular, so
+ * one lookup gives everything sampling needs in priority order.
+ *
+ * When the ranges span a small total value domain, the index additionally
+ * builds a dense table mapping each value of the domain directly to its range,
+ * turning a lookup into a single array access.
+ */
+template <typename T>
+class interval_index
+{
+public:
+
+  /*! Reference to one interval of a bin */
+  struct bin_ref
+  {
+    /*! Index of the bin in the bin vector of its type */
+    uint32_t bin;
+    /*! Index of the interval in the bin */
+    uint32_t interval;
+    /*! Type of the bin, selects the bin vector */
+    bin_t type;
+    /*! Position of the interval's hit counter, set by the owner of the index */
+    uint32_t counter;
+  };
+
+  /*! Storage type for bounds (avoids the std::vector<bool> specialization) */
+  typedef typename std::conditional<std::is_same<T, bool>::value, unsigned char, T>::type bound_t;
+
+  /*! Value returned by find() when no range contains the value */
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  /*! Indexes up to this size are searched linearly by find_batch() */
+  static constexpr size_t linear_search_max = 16;
+
+  /*! Sorted upper bounds of the ranges. This is the array being searched */
+  std::vector<bound_t> upper;
+
+  /*! Lower bounds of the ranges, parallel to upper */
+  std::vector<bound_t> lower;
+
+  /*! Bin references of range i are refs[offsets[i]] .. refs[offsets[i+1]-1] */
+  std::vector<uint32_t> offsets{0};
+
+  /*! Bin references for all ranges, stored back to back */
+  std::vector<bin_ref> refs;
+
+  /*! Smallest value covered by the dense table */
+  bound_t dense_base = bound_t();
+
+  /*! Range index + 1 for each value starting at dense_base, 0 if none */
+  std::vector<uint32_t> dense;
+
+  /*!
+   * \brief Rebuilds the index from a single interval map
+   * \param interval_map Map from disjoint interval to bin references, ordered
+   * by the upper bound of the interval
+   * \param dense_max_bytes Memory limit for the dense table. No dense table is
+   * built if the value domain of the ranges needs more than this
+   *
+   * All references are tagged as regular bins.
+   */
+  template <typename Map>
+  void build(const Map& interval_map, size_t dense_max_bytes = 0)
+  {
+    const Map* maps[] = { &interval_map };
+    const bin_t types[] = { default_ };
+    merge(maps, types, 1, dense_max_bytes);
+  }
+
+  /*!
+   * \brief Rebuilds the index from the interval maps of a coverpoint
+   * \param ignore_map Interval map of the ignore bins
+   * \param illegal_map Interval map of the illegal bins
+   * \param regular_map Interval map of the regular bins
+   * \param dense_max_bytes Memory limit for the dense table
+   */
+  template <typename Map>
+  void build(const Map& ignore_map, const Map& illegal_map,
+             const Map& regular_map, size_t dense_max_bytes = 0)
+  {
+    const Map* maps[] = { &ignore_map, &illegal_map, &regular_map };
+    const bin_t types[] = { ignore_, illegal_, default_ };
+    merge(maps, types, 3, dense_max_bytes);
+  }
+
+  /*!
+   * \brief Rebuilds the index from several interval maps
+   * \param maps Interval maps, in decreasing sampling priority
+   * \param types Bin type of the references of each map
+   * \param count Number of maps
+   * \param dense_max_bytes Memory limit for the dense table
+   *
+   * The intervals of different maps may overlap, so the value axis is cut at
+   * every interval boundary of every map. Each resulting range gets the
+   * references of all the map entries containing it, in map order.
+   */
+  template <typename Map>
+  void merge(const Map* const* maps, const bin_t* types, size_t count,
+             size_t dense_max_bytes)
+  {
+    clear();
+
+    // a range starts at every lower bound and right after every upper bound
+    std::vector<bound_t> cuts;
+    for (size_t m = 0; m < count; ++m)
+      for (auto& entry : *maps[m])
+      {
+        bound_t lo = entry.first.first;
+        bound_t hi = entry.first.second;
+        cuts.push_back(lo);
+        if (hi != max_bound()) cuts.push_back(bound_t(hi + 1));
+      }
+    std::sort(cuts.begin(), cuts.end());
+    cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+    std::vector<typename Map::const_iterator> it;
+    for (size_t m = 0; m < count; ++m)
+      it.push_back(maps[m]->begin());
+
+    upper.reserve(cuts.size());
+    lower.reserve(cuts.size());
+    offsets.reserve(cuts.size() + 1);
+    for (size_t c = 0; c < cuts.size(); ++c)
+    {
+      bound_t lo = cuts[c];
+      bound_t hi = (c + 1 < cuts.size()) ? bound_t(cuts[c + 1] - 1) : max_bound();
+      size_t first_ref = refs.size();
+      for (size_t m = 0; m < count; ++m)
+      {
+        while (it[m] != maps[m]->end() && bound_t(it[m]->first.second) < lo) ++it[m];
+        if (it[m] == maps[m]->end() || lo < bound_t(it[m]->first.first)) continue;
+        hi = std::min(hi, bound_t(it[m]->first.second));
+        for (auto& ref : it[m]->second)
+          refs.push_back({ ref.first, ref.second, types[m], 0 });
+      }
+      if (refs.size() == first_ref) continue;
+      lower.push_back(lo);
+      upper.push_back(hi);
+      offsets.push_back(refs.size());
+    }
+    build_dense(dense_max_bytes);
+  }
+
+  /*!
+   * \brief Builds the dense value-to-range table if the domain is small enough
+   * \param dense_max_bytes Memory limit for the table
+   */
+  void build_dense(size_t dense_max_bytes)
+  {
+    dense.clear();
+    if (upper.empty()) return;
+
+    uint64_t span = distance(lower.front(), upper.back());
+    if (span >= dense_max_bytes / sizeof(uint32_t)) return;
+
+    dense_base = lower.front();
+    dense.assign(span + 1, 0);
+    for (size_t i = 0; i < upper.size(); ++i)
+    {
+      uint64_t first = distance(dense_base, lower[i]);
+      uint64_t last = distance(dense_base, upper[i]);
+      std::fill(dense.begin() + first, dense.begin() + last + 1, i + 1);
+    }
+  }
+
+  /*! Removes all ranges */
+  void clear()
+  {
+    upper.clear();
+    lower.clear();
+    offsets.assign(1, 0);
+    refs.clear();
+    dense.clear();
+  }
+
+  bool empty() const
+  {
+    return upper.empty();
+  }
+
+  /*!
+   * \brief Finds the range containing a value
+   * \param val Value to search for
+   * \returns Index of the range containing val or npos if there is none
+   */
+  size_t find(const T& val) const
+  {
+    if (!dense.empty()) {
+      uint64_t off = distance(dense_base, val);
+      // values outside the table are outside of every range; empty slots
+      // hold 0 which wraps around to npos
+      return (off < dense.size()) ? static_cast<size_t>(dense[off]) - 1 : npos;
+    }
+
+    size_t len = upper.size();
+    if (len == 0) return npos;
+
+    const bound_t* first = upper.data();
+    while (len > 1) {
+      size_t half = len / 2;
+      first = (first[half] < val) ? first + half : first;
+      len -= half;
+    }
+    size_t pos = (first - upper.data()) + (*first < val);
+
+    if (pos == upper.size() || val < lower[pos]) return npos;
+    return pos;
+  }
+
+  /*!
+   * \brief Finds the ranges containing each value of an array
+   * \param vals Values to search for
+   * \param n Number of values
+   * \param out Receives the result of find() for each value
+   *
+   * Dense tables and short indexes are searched with branchless loops
+   * that the compiler can vectorize across the values.
+   */
+  void find_batch(const T* vals, size_t n, size_t* out) const
+  {
+    if (upper.empty()) {
+      std::fill(out, out + n, npos);
+    }
+    else if (!dense.empty()) {
+      const uint64_t size = dense.size();
+      for (size_t i = 0; i < n; ++i) {
+        uint64_t off = distance(dense_base, vals[i]);
+        bool in = off < size;
+        size_t slot = static_cast<size_t>(dense[in ? off : 0]) - 1;
+        out[i] = in ? slot : npos;
+      }
+    }
+    else if (upper.size() <= linear_search_max) {
+      // the range is the number of upper bounds below the value
+      const size_t len = upper.size();
+      for (size_t i = 0; i < n; ++i) {
+        size_t pos = 0;
+        for (size_t j = 0; j < len; ++j)
+          pos += (upper[j] < vals[i]);
+        bool in = (pos < len) && !(vals[i] < lower[pos < len ? pos : 0]);
+        out[i] = in ? pos : npos;
+      }
+    }
+    else {
+      for (size_t i = 0; i < n; ++i)
+        out[i] = find(vals[i]);
+    }
+  }
+
+  /*! First bin reference of range pos */
+  const bin_ref* refs_begin(size_t pos) const
+  {
+    return refs.data() + offsets[pos];
+  }
+
+  /*! Largest value a bound can take */
+  static bound_t max_bound()
+  {
+    return std::is_same<T, bool>::value ? bound_t(1) : std::numeric_limits<bound_t>::max();
+  }
+
+  /*! Number of values from lo to hi, minus one, computed without overflow */
+  static uint64_t distance(bound_t lo, bound_t hi)
+  {
+    return static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);
+  }
+
+  /*! One past the last bin reference of range pos */
+  const bin_ref* refs_end(size_t pos) const
+  {
+    return refs.data() + offsets[pos + 1];
+  }
+
+};
+
+template <typename T>
+constexpr size_t interval_index<T>::npos;
+
+template <typename T>
+constexpr size_t interval_index<T>::linear_search_max;
+
+} // namespace fc4sc
+
+#endif /* FC4SC_INDEX_HPP */
@@ -90,22 +90,22 @@ namespace fc4sc {
 
   template <typename T>
   static std::vector<interval_t<T>> reunion(const bin<T>& lhs, const std::vector<interval_t<T>>& rhs) {
-    return reunion(lhs.bin_data->intervals, rhs);
+    return reunion(lhs.bin_data->get_intervals(), rhs);
   }
 
   template <typename T>
   static std::vector<interval_t<T>> reunion(const bin<T>& lhs, const bin<T>& rhs) {
-    return reunion(lhs.bin_data->intervals, rhs.bin_data->intervals);
+    return reunion(lhs.bin_data->get_intervals(), rhs.bin_data->get_intervals());
   }
 
   template <typename T>
   static std::vector<interval_t<T>> intersection(const bin<T>& lhs, const std::vector<interval_t<T>>& rhs) {
-    return intersection(lhs.bin_data->intervals, rhs);
+    return intersection(lhs.bin_data->get_intervals(), rhs);
   }
 
   template <typename T>
   static std::vector<interval_t<T>> intersection(const bin<T>& lhs, const bin<T>& rhs) {
-    return intersection(lhs.bin_data->intervals, rhs.bin_data->intervals);
+    return intersection(lhs.bin_data->get_intervals(), rhs.bin_data->get_intervals());
   }
 
 }
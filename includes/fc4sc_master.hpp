@@ -88,9 +88,12 @@ public:
       tmp->file_id = cvg_file_id;
       tmp->line = cvg_line;
       tmp->cvg_insts.push_back(cvg_data);
+      tmp->coverage.parent = &fc4sc::global::get_coverage_cache(this->cntxt);
       type_data->cvg_type_table[cvg_type_name] = tmp;
     }
     cvg_data->type_data = type_data->cvg_type_table[cvg_type_name];
+    cvg_data->coverage.parent = &cvg_data->type_data->coverage;
+    cvg_data->coverage.invalidate();
   }
 
   void add_scp_data(scp_base_data_model* scp_data, std::string scp_type_name, unsigned int cvg_file_id, uint32_t cvg_line)
@@ -187,6 +190,9 @@ public:
 
     std::vector<scp_base_data_model*> top_scps;
 
+    /*! Coverage across all types, kept between queries */
+    coverage_cache coverage;
+
     /*! Table keeping file IDs corresponding to file names */
     std::unordered_map<unsigned int, std::string> file_id_to_name;
 
@@ -260,6 +266,7 @@ public:
 	scps_data[scp_type_name] = tmp;
       }
       scp_data->type_data = scps_data[scp_type_name];
+      coverage.invalidate();
     }
 
    /*!
@@ -284,19 +291,27 @@ public:
     */
     double internal_get_coverage()
     {
+      if (!coverage.stale()) return coverage.coverage;
+
+      general_coverage data_visitor;
       double res = 0;
       double weights = 0;
+      bool uncached = false;
 
       for (auto &scp_types : scps_data) {
         for (auto &types : scp_types.second->cvg_type_table) {
-          res += internal_get_coverage(scp_types.first,types.first) * internal_type_option(scp_types.first,types.first).weight;
-          weights += internal_type_option(scp_types.first,types.first).weight;
+          cvg_metadata &type_data = *types.second;
+          res += data_visitor.get_coverage(type_data) * type_data.type_option.weight;
+          weights += type_data.type_option.weight;
+          uncached = uncached || type_data.coverage.uncached;
         }
       }
 
-      if (scps_data.size() == 0) return 100;
-      if (weights == 0)        return 0;
-      return res / weights;
+      coverage.uncached = uncached;
+      if (scps_data.size() == 0)   coverage.coverage = 100;
+      else if (weights == 0)       coverage.coverage = 0;
+      else                         coverage.coverage = res / weights;
+      return coverage.coverage;
     }
 
    /*!
@@ -318,7 +333,7 @@ public:
      * \returns Double between 0 and 100
      */
     // TODO merge hit_bins
-    double internal_get_coverage(const std::string &scp_type, const std::string &type, int &hit_bins, int &total_bins)
+    double internal_get_coverage(const std::string &scp_type, const std::string &type, uint64_t &hit_bins, uint64_t &total_bins)
     {
       general_coverage data_visitor;
       return data_visitor.get_coverage(scp_type,type,hit_bins,total_bins,this);
@@ -357,8 +372,8 @@ public:
 
   uint64_t hitsum = 0;
 
-  int bin_total = 0;
-  int bin_covered = 0;
+  uint64_t bin_total = 0;
+  uint64_t bin_covered = 0;
 
   void visit(scp_base_data_model& base){ }
 
@@ -391,21 +406,17 @@ public:
   void visit(coverpoint_base_data_model& base)
   {
     cvp_weight = base.option.weight;
-    this->bin_total += base.bins_data.size();
-    if (base.bins_data.empty()) {
+    this->bin_total += base.bin_count();
+    if (base.bin_count() == 0) {
       cvp_res = (base.option.weight == 0) ? 100 : 0;
       return;
     }
 
-    double res = 0;
-    for (auto &bin : base.bins_data) {
-      bin->accept_visitor(*this);
-      res += (hitsum >= base.option.at_least);
-    }
+    uint64_t res = base.get_covered_bins();
 
     this->bin_covered += res;
 
-    double real = res * 100 / base.bins_data.size();
+    double real = 100.0 * res / base.bin_count();
 
     cvp_res = (real >= base.option.goal) ? 100 : real;
   }
@@ -414,13 +425,8 @@ public:
   {
     cvp_weight = base.option.weight;
     
-    int covered = 0;
-    int total = 1;
-
-    for(auto cvp_it : base.cross_cvps)
-    {
-      total *= cvp_it->size();
-    }
+    uint64_t covered = 0;
+    uint64_t total = base.size();
 
     this->bin_total += total;
 
@@ -429,11 +435,7 @@ public:
       return;
     }
 
-    for (auto it : base.get_cross_bins())
-    {
-      if (it.second >= base.option.at_least)
-        covered++;
-    }
+    covered = base.get_covered_bins();
     
     this->bin_covered += covered;
 
@@ -448,31 +450,84 @@ public:
       hitsum += hitcount;
   }
 
-  double get_coverage(const std::string &scp_type, const std::string &type, fc4sc::global* cvg_cntxt)
+  /*!
+   * \brief Sets cvg_res and cvg_weight for a covergroup instance and adds its
+   * bins, recomputed only if its coverage changed since the last query
+   */
+  void visit_cached(cvg_base_data_model& base)
   {
-    this->bin_total = 0;
-    this->bin_covered = 0;
+    coverage_cache &cache = base.coverage;
+    // Samples still queued mark the coverage once they are counted
+    if (base.async_worker) base.async_worker->drain();
+
+    if (cache.stale()) {
+      uint64_t covered = this->bin_covered;
+      uint64_t total = this->bin_total;
+      base.accept_visitor(*this);
+      cache.coverage = this->cvg_res;
+      cache.covered_bins = this->bin_covered - covered;
+      cache.total_bins = this->bin_total - total;
+      // Sharded sampling does not mark the bins it covers
+      cache.uncached = false;
+      for (auto &cvp : base.cvps)
+        cache.uncached = cache.uncached || cvp->sharded();
+    }
+    else {
+      this->cvg_res = cache.coverage;
+      this->bin_covered += cache.covered_bins;
+      this->bin_total += cache.total_bins;
+    }
+    this->cvg_weight = base.option.weight;
+  }
 
-    std::vector<cvg_base_data_model*> cvgs = fc4sc::global::get_scopes_data(cvg_cntxt)[scp_type]->cvg_type_table[type]->cvg_insts;
+  /*!
+   * \brief Computes the coverage across all instances of a type, only
+   * recomputing the instances whose coverage changed since the last query
+   */
+  double get_coverage(cvg_metadata& type_data)
+  {
+    coverage_cache &cache = type_data.coverage;
 
-    double res = 0;
-    double weights = 0;
+    if (cache.stale()) {
+      this->bin_total = 0;
+      this->bin_covered = 0;
 
-    for (auto it : cvgs)
-    {
-      it->accept_visitor(*this);
-      res += this->cvg_res * this->cvg_weight;
-      weights += this->cvg_weight;
+      double res = 0;
+      double weights = 0;
+      bool uncached = false;
+
+      for (auto it : type_data.cvg_insts)
+      {
+        visit_cached(*it);
+        res += this->cvg_res * this->cvg_weight;
+        weights += this->cvg_weight;
+        uncached = uncached || it->coverage.uncached || it->async_worker;
+      }
+
+      cache.covered_bins = this->bin_covered;
+      cache.total_bins = this->bin_total;
+      cache.uncached = uncached;
+
+      if (weights == 0 || type_data.cvg_insts.size() == 0 || res == 0) {
+        cache.coverage = (type_data.type_option.weight == 0) ? 100 : 0;
+      }
+      else {
+        double real = res / weights;
+        cache.coverage = (real >= type_data.type_option.goal) ? 100 : real;
+      }
     }
 
-    if (weights == 0 || cvgs.size() == 0 || res == 0)
-      return (fc4sc::global::get_scopes_data(cvg_cntxt)[scp_type]->cvg_type_table[type]->type_option.weight == 0) ? 100 : 0;
+    this->bin_covered = cache.covered_bins;
+    this->bin_total = cache.total_bins;
+    return cache.coverage;
+  }
 
-    double real = res / weights;
-    return (real >= fc4sc::global::get_scopes_data(cvg_cntxt)[scp_type]->cvg_type_table[type]->type_option.goal) ? 100 : real;
+  double get_coverage(const std::string &scp_type, const std::string &type, fc4sc::global* cvg_cntxt)
+  {
+    return get_coverage(*fc4sc::global::get_scopes_data(cvg_cntxt)[scp_type]->cvg_type_table[type]);
   }
 
-    double get_coverage(const std::string &scp_type, const std::string &type, int &hit_bins, int &total_bins, fc4sc::global* cvg_cntxt)
+    double get_coverage(const std::string &scp_type, const std::string &type, uint64_t &hit_bins, uint64_t &total_bins, fc4sc::global* cvg_cntxt)
     {
       double ret = get_coverage(scp_type, type, cvg_cntxt);
       hit_bins = this->bin_covered;
@@ -554,6 +609,14 @@ public:
     return cvg_cntxt->internal_get_scopes_data();
   }
 
+  /*!
+   * \brief get the coverage cache at the top of the caches of a context
+  */
+  static coverage_cache& get_coverage_cache(fc4sc::global* cvg_cntxt = fc4sc::global::getter())
+  {
+    return cvg_cntxt->coverage;
+  }
+
   /*!
    * \brief get list of top scopes data model
   */
@@ -588,11 +651,25 @@ public:
    * \param total_bins Total number of bins across instances of same type
    * \returns Double between 0 and 100
    */
-  static double get_coverage(const std::string &scp_type, const std::string &type, int &hit_bins, int &total_bins, fc4sc::global* cvg_cntxt = fc4sc::global::getter())
+  static double get_coverage(const std::string &scp_type, const std::string &type, uint64_t &hit_bins, uint64_t &total_bins, fc4sc::global* cvg_cntxt = fc4sc::global::getter())
   {
     return cvg_cntxt->internal_get_coverage(scp_type, type, hit_bins, total_bins);
   }
 
+  /*!
+   * \brief int version of get_coverage(scp_type, type, uint64_t&, uint64_t&,
+   * global*), kept for source compatibility. Counts past INT_MAX are reported
+   * as INT_MAX
+   */
+  static double get_coverage(const std::string &scp_type, const std::string &type, int &hit_bins, int &total_bins, fc4sc::global* cvg_cntxt = fc4sc::global::getter())
+  {
+    uint64_t hit_bins64 = 0, total_bins64 = 0;
+    double res = get_coverage(scp_type, type, hit_bins64, total_bins64, cvg_cntxt);
+    hit_bins = saturate_to_int(hit_bins64);
+    total_bins = saturate_to_int(total_bins64);
+    return res;
+  }
+
   static bool is_empty(fc4sc::global* cvg_cntxt = fc4sc::global::getter())
   {
     return cvg_cntxt->empty();
@@ -36,6 +36,106 @@
 
 #include <string>
 #include <ostream>
+#include <stdint.h>
+
+namespace fc4sc
+{
+struct coverage_cache;
+
+/*! Marks a coverage cache and the caches above it as changed */
+inline void invalidate_coverage(coverage_cache* cache);
+
+/*!
+ * \class coverage_option fc_options.hpp
+ * \brief Option the coverage depends on
+ *
+ * Reads as the plain value. Writing it marks the coverage cache it is bound
+ * to as changed, so that coverage queries do not have to compare the
+ * options. Copies are not bound.
+ */
+template <typename T>
+class coverage_option
+{
+  T value;
+  coverage_cache* cache = nullptr;
+
+public:
+  coverage_option(T value = T()) : value(value) { }
+
+  coverage_option(const coverage_option& other) : value(other.value) { }
+
+  coverage_option& operator=(const coverage_option& other)
+  {
+    return *this = other.value;
+  }
+
+  coverage_option& operator=(T new_value)
+  {
+    value = new_value;
+    if (cache) invalidate_coverage(cache);
+    return *this;
+  }
+
+  operator T() const { return value; }
+
+  /*! Marks cache as changed on every later write */
+  void bind(coverage_cache* cache)
+  {
+    this->cache = cache;
+  }
+};
+} // namespace fc4sc
+
+/*!
+ * Default memory limit (in bytes) for the dense value-to-bin lookup table
+ * that coverpoints build when their bins span a small value domain.
+ * Can be overridden at compile time or per coverpoint through
+ * cvp_option::dense_lookup_max_bytes. The default covers a full 16-bit domain.
+ */
+#ifndef FC4SC_DENSE_LOOKUP_MAX_BYTES
+#define FC4SC_DENSE_LOOKUP_MAX_BYTES (256 * 1024)
+#endif
+
+/*!
+ * Default memory limit (in bytes) for the dense counter array of a cross,
+ * holding one counter for every combination of bins of the crossed
+ * coverpoints. Larger crosses store their hit bins in a hash table instead.
+ * Can be overridden at compile time or per cross through
+ * cross_option::dense_bins_max_bytes.
+ */
+#ifndef FC4SC_CROSS_DENSE_MAX_BYTES
+#define FC4SC_CROSS_DENSE_MAX_BYTES (1024 * 1024)
+#endif
+
+/*!
+ * Default number of cross bins from which a cross that does not fit the
+ * dense layout records its hit bins in compressed bitmaps, plus a table of
+ * the counts of bins hit more than once. Can be overridden at compile time or
+ * per cross through cross_option::bitmap_min_bins.
+ */
+#ifndef FC4SC_CROSS_BITMAP_MIN_BINS
+#define FC4SC_CROSS_BITMAP_MIN_BINS (uint64_t(1) << 32)
+#endif
+
+/*!
+ * Maximum number of regular bins of one coverpoint recorded as hit by a
+ * single sample, when the bins overlap. Crosses combine the recorded bins,
+ * further bins are counted by the coverpoint but not crossed. Such samples
+ * are counted in truncated_samples and reported on the first one.
+ */
+#ifndef FC4SC_MAX_HIT_BINS
+#define FC4SC_MAX_HIT_BINS 8
+#endif
+
+/*!
+ * Default maximum number of cross bins counted by a single sample, when the
+ * crossed coverpoints hit several overlapping bins. Can be overridden at
+ * compile time or per cross through cross_option::max_hit_combinations.
+ * Samples going past it are counted in truncated_samples.
+ */
+#ifndef FC4SC_CROSS_MAX_HIT_COMBINATIONS
+#define FC4SC_CROSS_MAX_HIT_COMBINATIONS 64
+#endif
 
 /*!
  * \class cvg_option fc_options.hpp
@@ -44,10 +144,10 @@
 struct cvg_option
 {
   /*! Weight of instance when computing coverage */
-  uint weight;
+  fc4sc::coverage_option<uint> weight;
 
   /*! Target coverage percentage */
-  uint goal;
+  fc4sc::coverage_option<uint> goal;
 
   /*! Comment for this coverage */
   std::string comment;
@@ -70,6 +170,15 @@ struct cvg_option
   /*! !UNIPLEMENTED! Enables covergroup::get_inst_coverage() */
   bool get_inst_coverage;
 
+  /*!
+   * Applies stop_at_goal, with this at_goal_sample_period, to every
+   * coverpoint and cross of the covergroup
+   */
+  bool stop_at_goal;
+
+  /*! Sampling period of the coverpoints and crosses stopped at goal */
+  uint at_goal_sample_period;
+
   /*!
    * \brief Sets all values to default
    */
@@ -84,6 +193,15 @@ struct cvg_option
     this->cross_num_print_missing = 0;
     this->per_instance = 0;
     this->get_inst_coverage = 0;
+    this->stop_at_goal = false;
+    this->at_goal_sample_period = 0;
+  }
+
+  /*! Marks cache as changed when weight or goal is written */
+  void bind(fc4sc::coverage_cache* cache)
+  {
+    weight.bind(cache);
+    goal.bind(cache);
   }
 
 };
@@ -95,16 +213,16 @@ struct cvg_option
 struct cvp_option
 {
   /*! Weight of instance when computing coverage */
-  uint weight;
+  fc4sc::coverage_option<uint> weight;
 
   /*! Target coverage percentage */
-  uint goal;
+  fc4sc::coverage_option<uint> goal;
 
   /*! Comment for this coverage */
   std::string comment;
 
   /*! Minimum of hits for each bin */
-  uint at_least;
+  fc4sc::coverage_option<uint> at_least;
 
   /*! !UNIPLEMENTED! Max number of generated bins */
   uint auto_bin_max;
@@ -112,6 +230,28 @@ struct cvp_option
   /*! !UNIPLEMENTED! Issue warning if bins overlap in cvp */
   bool detect_overlap;
 
+  /*!
+   * Memory limit for the dense value-to-bin lookup table. Read when the
+   * lookup index is built (on the first sample after the bins change);
+   * 0 disables the dense table
+   */
+  uint dense_lookup_max_bytes;
+
+  /*!
+   * Cuts back the sampling done by the covergroup once the coverage reaches
+   * goal, as at_goal_sample_period says. Its hit counts then stop being
+   * totals, which the coverage report notes. Not checked while sampling is
+   * sharded. Coverpoints keep being sampled while crossed by a cross
+   * still sampled
+   */
+  bool stop_at_goal;
+
+  /*!
+   * Once stop_at_goal triggered, 0 stops sampling and N keeps one
+   * covergroup sample in N
+   */
+  uint at_goal_sample_period;
+
   /*!
    * \brief Sets all values to default
    */
@@ -122,6 +262,17 @@ struct cvp_option
     this->at_least = 1;
     this->auto_bin_max = 10;
     this->detect_overlap = 0;
+    this->dense_lookup_max_bytes = FC4SC_DENSE_LOOKUP_MAX_BYTES;
+    this->stop_at_goal = false;
+    this->at_goal_sample_period = 0;
+  }
+
+  /*! Marks cache as changed when weight, goal or at_least is written */
+  void bind(fc4sc::coverage_cache* cache)
+  {
+    weight.bind(cache);
+    goal.bind(cache);
+    at_least.bind(cache);
   }
 
 };
@@ -133,20 +284,56 @@ struct cvp_option
 struct cross_option // cross option declaration
 {
   /*! Weight of instance when computing coverage */
-  uint weight;
+  fc4sc::coverage_option<uint> weight;
 
   /*! Target coverage percentage */
-  uint goal;
+  fc4sc::coverage_option<uint> goal;
 
   /*! Comment for this coverage */
   std::string comment;
 
   /*! Minimum of hits for each bin */
-  uint at_least;
+  fc4sc::coverage_option<uint> at_least;
 
-  /*! !UNIPLEMENTED! Number of missing bins in crosses to be printed */
+  /*!
+   * Number of missing cross bins listed in the coverage report, found by
+   * walking the bins of the cross in order
+   */
   uint cross_num_print_missing;
 
+  /*!
+   * Memory limit for the dense cross bin counters. Read when the cross bin
+   * storage is laid out (on the first sample and when the crossed
+   * coverpoints get new bins); 0 always stores the bins in a hash table
+   */
+  uint dense_bins_max_bytes;
+
+  /*!
+   * Maximum number of cross bins counted by one sample whose values hit
+   * several overlapping bins of the crossed coverpoints; 0 is treated as 1
+   */
+  uint max_hit_combinations;
+
+  /*!
+   * Number of cross bins from which the hit bins are stored in compressed
+   * bitmaps instead of a hash table. Read when the storage is laid out
+   */
+  uint64_t bitmap_min_bins;
+
+  /*!
+   * Cuts back the sampling done by the covergroup once the coverage reaches
+   * goal, as at_goal_sample_period says. Its hit counts then stop being
+   * totals, which the coverage report notes. Not checked while sampling is
+   * sharded
+   */
+  bool stop_at_goal;
+
+  /*!
+   * Once stop_at_goal triggered, 0 stops sampling and N keeps one
+   * covergroup sample in N
+   */
+  uint at_goal_sample_period;
+
   /*!
    * \brief Sets all values to default
    */
@@ -156,6 +343,19 @@ struct cross_option // cross option declaration
     goal = 100;
     at_least = 1;
     cross_num_print_missing = 0;
+    dense_bins_max_bytes = FC4SC_CROSS_DENSE_MAX_BYTES;
+    max_hit_combinations = FC4SC_CROSS_MAX_HIT_COMBINATIONS;
+    bitmap_min_bins = FC4SC_CROSS_BITMAP_MIN_BINS;
+    stop_at_goal = false;
+    at_goal_sample_period = 0;
+  }
+
+  /*! Marks cache as changed when weight, goal or at_least is written */
+  void bind(fc4sc::coverage_cache* cache)
+  {
+    weight.bind(cache);
+    goal.bind(cache);
+    at_least.bind(cache);
   }
 
 };
@@ -167,10 +367,10 @@ struct cross_option // cross option declaration
 struct cvg_type_option // covergroup type_option declaration
 {
   /*! Weight of instance when computing coverage */
-  uint weight;
+  fc4sc::coverage_option<uint> weight;
 
   /*! Target coverage percentage */
-  uint goal;
+  fc4sc::coverage_option<uint> goal;
 
   /*! Comment for this coverage */
   std::string comment;
@@ -187,6 +387,13 @@ struct cvg_type_option // covergroup type_option declaration
     this->goal = 100;
     this->merge_instances = 0;
   }
+
+  /*! Marks cache as changed when weight or goal is written */
+  void bind(fc4sc::coverage_cache* cache)
+  {
+    weight.bind(cache);
+    goal.bind(cache);
+  }
 };
 
 #endif /* FC4SC_OPTIONS_HPP */
@@ -0,0 +1,231 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+
+/*!
+ \file fc4sc_sample_queue.hpp
+ \brief Queue of samples counted by a worker thread
+
+   A covergroup sampling asynchronously only copies the values it samples
+ into a queue. The bins are looked up and the counters updated by a worker
+ thread reading the queue. This file contains the queue and the worker.
+ */
+
+#ifndef FC4SC_SAMPLE_QUEUE_HPP
+#define FC4SC_SAMPLE_QUEUE_HPP
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstddef>
+
+namespace fc4sc
+{
+
+/*!
+ * \class sample_ring fc4sc_sample_queue.hpp
+ * \brief Lock-free queue of fixed size records, for one producer thread and
+ * one consumer thread
+ *
+ * Records are written in place: the producer fills the slot returned by
+ * back() and publishes it with push(), the consumer reads the slot returned
+ * by front() and releases it with pop().
+ */
+class sample_ring
+{
+  /*! Size of a record in bytes */
+  size_t record_size;
+
+  /*! Number of record slots minus one; the number of slots is a power of 2 */
+  size_t mask;
+
+  /*! Record slots */
+  std::vector<unsigned char> slots;
+
+  /*! Number of records pushed, written by the producer */
+  std::atomic<size_t> head{0};
+
+  /*! Keeps head and tail on different cache lines */
+  char pad_head[64];
+
+  /*! Number of records popped, written by the consumer */
+  std::atomic<size_t> tail{0};
+
+  /*! Keeps tail and the producer's cached tail on different cache lines */
+  char pad_tail[64];
+
+  /*! Last tail seen by the producer, saves reading tail on every push */
+  size_t tail_seen = 0;
+
+public:
+
+  /*!
+   * \param record_size Size of a record in bytes
+   * \param capacity Minimum number of records queued at once
+   */
+  sample_ring(size_t record_size, size_t capacity) : record_size(record_size ? record_size : 1)
+  {
+    size_t slot_count = 2;
+    while (slot_count < capacity) slot_count *= 2;
+    mask = slot_count - 1;
+    slots.resize(slot_count * this->record_size);
+  }
+
+  /*! Producer: slot of the next record, or nullptr while the queue is full */
+  unsigned char* back()
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail_seen > mask) {
+      tail_seen = tail.load(std::memory_order_acquire);
+      if (h - tail_seen > mask) return nullptr;
+    }
+    return &slots[(h & mask) * record_size];
+  }
+
+  /*! Producer: publishes the record written to back() */
+  void push()
+  {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /*! Consumer: oldest record, or nullptr while the queue is empty */
+  const unsigned char* front() const
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return nullptr;
+    return &slots[(t & mask) * record_size];
+  }
+
+  /*! Consumer: releases the record returned by front() */
+  void pop()
+  {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /*! True once the consumer popped every record pushed */
+  bool empty() const
+  {
+    return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+  }
+};
+
+/*!
+ * \class sample_worker fc4sc_sample_queue.hpp
+ * \brief Thread consuming the records of a sample_ring
+ *
+ * The thread spins briefly when the queue runs empty, then sleeps between
+ * polls so an idle worker does not keep a core busy.
+ */
+class sample_worker
+{
+  sample_ring ring;
+
+  /*! Counts one record, on the worker thread */
+  std::function<void(const unsigned char*)> consume;
+
+  /*! Set by stop() to end the worker once the queue is empty */
+  std::atomic<bool> stopping{false};
+
+  std::thread thread;
+
+  void run()
+  {
+    unsigned idle = 0;
+    for (;;) {
+      const unsigned char* record = ring.front();
+      if (record) {
+        consume(record);
+        ring.pop();
+        idle = 0;
+      }
+      else if (stopping.load(std::memory_order_acquire)) {
+        if (ring.empty()) return;
+      }
+      else if (++idle < 256) {
+        std::this_thread::yield();
+      }
+      else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    }
+  }
+
+public:
+
+  /*!
+   * \param record_size Size of a record in bytes
+   * \param capacity Minimum number of records queued at once
+   * \param consume Counts one record, called on the worker thread
+   */
+  sample_worker(size_t record_size, size_t capacity, std::function<void(const unsigned char*)> consume)
+    : ring(record_size, capacity), consume(consume)
+  {
+    thread = std::thread(&sample_worker::run, this);
+  }
+
+  /*! Disabled */
+  sample_worker(const sample_worker&) = delete;
+  /*! Disabled */
+  sample_worker& operator=(const sample_worker&) = delete;
+
+  /*!
+   * \brief Slot of the next record, waiting while the queue is full
+   * \returns Memory to write the record to, published by push()
+   */
+  unsigned char* back()
+  {
+    unsigned char* record;
+    while ((record = ring.back()) == nullptr)
+      std::this_thread::yield();
+    return record;
+  }
+
+  /*! Publishes the record written to back() */
+  void push()
+  {
+    ring.push();
+  }
+
+  /*!
+   * \brief Waits until every record pushed has been counted. Counters
+   * updated by the worker are then visible to the calling thread
+   */
+  void drain()
+  {
+    while (!ring.empty())
+      std::this_thread::yield();
+  }
+
+  /*! Counts the queued records and ends the worker thread */
+  void stop()
+  {
+    if (!thread.joinable()) return;
+    stopping.store(true, std::memory_order_release);
+    thread.join();
+  }
+
+  ~sample_worker()
+  {
+    stop();
+  }
+};
+
+} // namespace fc4sc
+
+#endif /* FC4SC_SAMPLE_QUEUE_HPP */
@@ -112,9 +112,12 @@ public:
       tmp->file_id = cvg_file_id;
       tmp->line = cvg_line;
       tmp->cvg_insts.push_back(cvg_data);
+      tmp->coverage.parent = &fc4sc::global::get_coverage_cache(this->cntxt);
       type_data->cvg_type_table[cvg_type_name] = tmp;
     }
     cvg_data->type_data = type_data->cvg_type_table[cvg_type_name];
+    cvg_data->coverage.parent = &cvg_data->type_data->coverage;
+    cvg_data->coverage.invalidate();
   }
 
   void add_scp_data(scp_base_data_model* scp_data, std::string scp_type_name, unsigned int scp_file_id, uint32_t scp_line)
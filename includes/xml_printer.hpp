@@ -333,6 +333,27 @@ public:
 
   }
 
+  /*!
+   * \brief Notes that the sampling of a coverpoint or cross was cut back at
+   * its goal, with the sampling period kept (0 when stopped), since its hit
+   * counts are then not totals
+   */
+  void print_goal_reached(fc4sc::cvp_base_data_model& base)
+  {
+    if (!base.sampling_cut) return;
+    stream << "<userAttr key=\"atGoalSamplePeriod\" type=\"int\">"
+           << base.at_goal_sample_period << "</userAttr>\n";
+  }
+
+  // samples whose hits were not all crossed
+  void print_truncated_samples(fc4sc::cvp_base_data_model& base)
+  {
+    uint64_t truncated = base.truncated_samples.load(std::memory_order_relaxed);
+    if (truncated == 0) return;
+    stream << "<userAttr key=\"truncatedSamples\" type=\"int\">"
+           << truncated << "</userAttr>\n";
+  }
+
   void visit(fc4sc::coverpoint_base_data_model& base)
   {
     stream << "<coverpoint ";
@@ -353,6 +374,7 @@ public:
     stream << "detect_overlap=\"" << inst.detect_overlap << "\" ";
     stream << "/>\n";
 
+    base.create_bins_data();
     for (auto bin : base.bins_data)
       bin->accept_visitor(*this);
     for (auto bin : base.illegal_bins_data)
@@ -360,6 +382,9 @@ public:
     for (auto bin : base.ignore_bins_data)
       bin->accept_visitor(*this);
 
+    print_goal_reached(base);
+    print_truncated_samples(base);
+
     stream << "</coverpoint>\n\n";
   }
 
@@ -372,7 +397,6 @@ public:
            << "\" ";
     stream << ">\n";
     
-  //TODO: cross_num_print_missing is unimplemented
     auto& inst = base.option;
     stream << "<options ";
     stream << "weight=\"" << inst.weight << "\" ";
@@ -388,9 +412,37 @@ public:
       stream << "<crossExpr>" << cvp->name << "</crossExpr> \n";
     }
 
-    auto cross_bins = base.get_cross_bins();
+    // cross bins are printed straight from the counters, without a copy
+    const size_t arity = base.cross_cvps.size();
+    bool any_hit = false;
+    base.for_each_cross_bin([this, arity, &any_hit](const size_t* idx, uint64_t count)
+    {
+      any_hit = true;
+      stream << "<crossBin \n";
+      stream << "name=\""
+             << ""
+             << "\"  \n";
+      stream << "key=\"" << get_unique_key() << "\" \n";
+      //Cannot specify type attribute b/c URG bug
+      //stream << "type=\""
+      //       << "default"
+      //       << "\" \n";
+    
+      stream << "> \n";
+
+      for (size_t i = 0; i < arity; i++)
+        stream << "<index>" << idx[i] << "</index>\n";
+
+      stream << "<contents \n";
+      stream << "coverageCount=\"" << count << "\"> \n";
+      stream << "</contents> \n";
 
-    if (cross_bins.empty())
+      stream << "</crossBin> \n";
+    });
+
+    auto user_bins = base.get_user_bins();
+
+    if (!any_hit && user_bins.empty())
     {
       //edge case where crossbin is never sampled
       stream << "<crossBin \n";
@@ -403,9 +455,6 @@ public:
              << "\" \n";
       stream << "> \n";
 
-      for (unsigned int i = 0; i < base.get_cross_bins().size(); i++) 
-       stream << "<index>" << 0 << "</index>\n";
-
       stream << "<contents \n";
       stream << "coverageCount=\"" << 0 << "\"> \n";
       stream << "</contents> \n";
@@ -413,30 +462,42 @@ public:
       stream << "</crossBin> \n";
     }
 
-    for (auto& bin : cross_bins)
+    // user-defined bins select several combinations, so their indexes are -1
+    for (auto& bin : user_bins)
     {
       stream << "<crossBin \n";
       stream << "name=\""
-             << ""
+             << escape_xml_chars(bin.name)
              << "\"  \n";
       stream << "key=\"" << get_unique_key() << "\" \n";
-      //Cannot specify type attribute b/c URG bug
-      //stream << "type=\""
-      //       << "default"
-      //       << "\" \n";
-    
+      if (bin.type != fc4sc::default_)
+        stream << "type=\""
+               << ((bin.type == fc4sc::illegal_) ? "illegal" : "ignore")
+               << "\" \n";
       stream << "> \n";
 
-      for (auto& index : bin.first)
-        stream << "<index>" << index << "</index>\n";
+      for (size_t i = 0; i < base.cross_cvps.size(); i++)
+        stream << "<index>" << -1 << "</index>\n";
 
       stream << "<contents \n";
-      stream << "coverageCount=\"" << bin.second << "\"> \n";
+      stream << "coverageCount=\"" << bin.hits << "\"> \n";
       stream << "</contents> \n";
 
       stream << "</crossBin> \n";
     }
 
+    // the first cross_num_print_missing holes, as tuples of bin indexes
+    for (auto& missing : base.get_missing_bins(inst.cross_num_print_missing))
+    {
+      stream << "<userAttr key=\"missing\" type=\"str\">";
+      for (size_t i = 0; i < missing.size(); i++)
+        stream << (i ? "," : "") << missing[i];
+      stream << "</userAttr>\n";
+    }
+
+    print_goal_reached(base);
+    print_truncated_samples(base);
+
       stream << "</cross>\n"; 
   }
 
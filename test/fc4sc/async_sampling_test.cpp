@@ -0,0 +1,147 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+#include "fc4sc.hpp"
+#include "xml_printer.hpp"
+#include "gtest/gtest.h"
+
+class async_cvg : public covergroup {
+public:
+  CG_CONS(async_cvg) { }
+
+  int value = 0;
+  int mode = 0;
+
+  COVERPOINT(int, value_cvp, value) {
+    bin_array<int>("values", 8, interval(0,7)),
+    ignore_bin<int>("ignored", 100),
+    illegal_bin<int>("illegal", 666)
+  };
+
+  COVERPOINT(int, mode_cvp, mode, value < 8) {
+    bin<int>("even", 0),
+    bin<int>("odd", 1)
+  };
+
+  cross<int,int> value_mode = cross<int,int>(this, "value_mode", &value_cvp, &mode_cvp);
+};
+
+TEST(async_sampling, matches_sync) {
+  auto cntxt = fc4sc::global::create_new_context();
+  async_cvg sync("sync",__FILE__,__LINE__,cntxt);
+  async_cvg async("async",__FILE__,__LINE__,cntxt);
+  EXPECT_TRUE(async.set_async_sampling(16));
+
+  // more samples than the queue holds, so sample() waits for the worker
+  for (int i = 0; i < 5000; ++i) {
+    for (auto cvg : { &sync, &async }) {
+      cvg->value = (i % 11 == 10) ? 100 : i % 10;
+      cvg->mode = i % 2;
+      cvg->sample();
+    }
+  }
+
+  // covergroup queries count the queued samples first
+  EXPECT_EQ(async.get_inst_coverage(), sync.get_inst_coverage());
+  for (uint32_t i = 0; i < sync.value_cvp.size(); ++i)
+    EXPECT_EQ(async.value_cvp.get_bin_hit_count(i), sync.value_cvp.get_bin_hit_count(i));
+  EXPECT_EQ(async.value_cvp.get_misses(), sync.value_cvp.get_misses());
+  EXPECT_EQ(async.mode_cvp.get_bin_hit_count(1), sync.mode_cvp.get_bin_hit_count(1));
+  EXPECT_EQ(async.value_mode.get_cross_bins(), sync.value_mode.get_cross_bins());
+  EXPECT_EQ(async.value_mode.get_misses(), sync.value_mode.get_misses());
+
+  // back to synchronous sampling, with the counts kept
+  async.value = 3;
+  async.sample();
+  EXPECT_TRUE(async.set_async_sampling(0));
+  async.sample();
+  EXPECT_EQ(async.value_cvp.get_bin_hit_count(3), sync.value_cvp.get_bin_hit_count(3) + 2);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(async_sampling, drained_by_visitors) {
+  auto cntxt = fc4sc::global::create_new_context();
+  async_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+  cvg.set_async_sampling(1024);
+
+  for (int i = 0; i < 8; ++i) {
+    cvg.value = i;
+    cvg.mode = i % 2;
+    cvg.sample();
+  }
+
+  uint64_t hit = 0, total = 0;
+  fc4sc::global::get_coverage(cvg.scp_type_name(), "async_cvg", hit, total, cntxt);
+  EXPECT_EQ(total, 8u + 2 + 16);
+  EXPECT_EQ(hit, 8u + 2 + 8);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(async_sampling, illegal_bin) {
+  auto cntxt = fc4sc::global::create_new_context();
+  async_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+  cvg.set_async_sampling(64);
+
+  cvg.value = 666;
+  cvg.sample();
+  EXPECT_THROW(cvg.drain_samples(), fc4sc::illegal_bin_sample_exception);
+
+  // reported once, later samples count normally
+  cvg.value = 1;
+  cvg.sample();
+  cvg.drain_samples();
+  EXPECT_EQ(cvg.value_cvp.get_bin_hit_count(1), 1u);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(async_sampling, stop_at_goal) {
+  auto cntxt = fc4sc::global::create_new_context();
+  async_cvg sync("sync",__FILE__,__LINE__,cntxt);
+  async_cvg async("async",__FILE__,__LINE__,cntxt);
+  for (auto cvg : { &sync, &async }) {
+    cvg->value_cvp.option().stop_at_goal = true;
+    cvg->value_mode.option().stop_at_goal = true;
+  }
+  EXPECT_TRUE(async.set_async_sampling(1 << 16));
+
+  // the objects reach their goal while the worker is still counting
+  for (int i = 0; i < 20000; ++i) {
+    for (auto cvg : { &sync, &async }) {
+      cvg->value = i % 8;
+      cvg->mode = (i / 8) % 2;
+      cvg->sample();
+    }
+  }
+  async.drain_samples();
+  // the goals are seen by the next sample at the latest
+  for (auto cvg : { &sync, &async })
+    cvg->sample();
+  async.drain_samples();
+
+  // samples queued before the sampling thread saw the goals are counted
+  EXPECT_TRUE(async.value_cvp.get_data()->sampling_cut);
+  EXPECT_TRUE(async.value_mode.get_data()->sampling_cut);
+  for (uint32_t i = 0; i < sync.value_cvp.size(); ++i)
+    EXPECT_GE(async.value_cvp.get_bin_hit_count(i), sync.value_cvp.get_bin_hit_count(i));
+  EXPECT_EQ(async.mode_cvp.get_bin_hit_count(0), sync.mode_cvp.get_bin_hit_count(0));
+  EXPECT_EQ(async.get_inst_coverage(), sync.get_inst_coverage());
+
+  fc4sc::global::delete_context(cntxt);
+}
@@ -54,3 +54,89 @@ TEST(coverpoint, control) {
   fc4sc::global::delete_context(cntxt);
 
 }
+
+/*! Number of times the bins of shared_schema_cvg were declared */
+static int shared_schema_declarations = 0;
+
+class shared_schema_cvg : public covergroup {
+public:
+  CG_CONS(shared_schema_cvg) {};
+  int value = 0;
+
+  int declared_count() { ++shared_schema_declarations; return 4; }
+
+  COVERPOINT(int, value_cvp, value) {
+    bin_array<int>("values", declared_count(), interval(0,15)),
+    illegal_bin<int>("illegal", 100)
+  };
+};
+
+class instance_bins_cvg : public covergroup {
+public:
+  CG_CONS(instance_bins_cvg, uint64_t count = 4), count(count) {};
+  uint64_t count;
+  int value = 0;
+
+  bool shared_bins() const { return false; }
+
+  COVERPOINT(int, value_cvp, value) {
+    bin_array<int>("values", count, interval(0,15))
+  };
+};
+
+TEST(coverpoint, shared_schema) {
+  auto cntxt = fc4sc::global::create_new_context();
+  shared_schema_cvg cvg1("cvg1",__FILE__,__LINE__,cntxt);
+  shared_schema_cvg cvg2("cvg2",__FILE__,__LINE__,cntxt);
+
+  // the bins are declared by the first instance of the type only
+  EXPECT_EQ(shared_schema_declarations, 1);
+  auto data1 = static_cast<fc4sc::coverpoint_base_data_model*>(cvg1.value_cvp.get_data());
+  auto data2 = static_cast<fc4sc::coverpoint_base_data_model*>(cvg2.value_cvp.get_data());
+  ASSERT_NE(data1->schema_data, nullptr);
+  EXPECT_EQ(data1->schema_data, data2->schema_data);
+  EXPECT_EQ(data1->bin_count(), 4u);
+  EXPECT_EQ(data1->hit_counters.size(), 5u);
+  EXPECT_TRUE(data1->bins_data.empty());
+
+  // but not their counters
+  cvg1.value = 5;
+  cvg1.sample();
+  EXPECT_EQ(cvg1.value_cvp.get_bin_hit_count(1), 1u);
+  EXPECT_EQ(cvg2.value_cvp.get_bin_hit_count(1), 0u);
+  EXPECT_EQ(cvg1.get_inst_coverage(), 25);
+  EXPECT_EQ(cvg2.get_inst_coverage(), 0);
+
+  cvg2.value = 100;
+  EXPECT_THROW(cvg2.sample(), fc4sc::illegal_bin_sample_exception);
+  EXPECT_EQ(cvg1.value_cvp.get_illegal_bins_base()[0]->get_hitcount(), 0u);
+  EXPECT_EQ(cvg2.value_cvp.get_illegal_bins_base()[0]->get_hitcount(), 1u);
+
+  // the bin data is only created for introspection
+  data1->create_bins_data();
+  ASSERT_EQ(data1->bins_data.size(), 4u);
+  EXPECT_EQ(data1->bins_data[1]->get_name(), "values[1]");
+  EXPECT_EQ(data1->bins_data[1]->get_interval_hits()[0], 1u);
+  EXPECT_EQ(cvg1.value_cvp.get_bins_base()[1]->get_hitcount(), 1u);
+
+  // bins added to an instance are its own
+  bin<int>("extra", 50).add_to_cvp(cvg2.value_cvp);
+  cvg2.value = 50;
+  cvg2.sample();
+  EXPECT_EQ(cvg2.value_cvp.size(), 5u);
+  EXPECT_EQ(cvg1.value_cvp.size(), 4u);
+  EXPECT_EQ(cvg2.value_cvp.get_bin_hit_count(4), 1u);
+  EXPECT_EQ(cvg2.value_cvp.get_illegal_bins_base()[0]->get_hitcount(), 1u);
+  cvg1.value = 50;
+  cvg1.sample();
+  EXPECT_EQ(cvg1.value_cvp.get_misses(), 1u);
+
+  // covergroups whose bins differ between instances do not share them
+  instance_bins_cvg cvg4("cvg4",__FILE__,__LINE__,cntxt);
+  instance_bins_cvg cvg8("cvg8",__FILE__,__LINE__,cntxt,8);
+  EXPECT_EQ(cvg4.value_cvp.size(), 4u);
+  EXPECT_EQ(cvg8.value_cvp.size(), 8u);
+  EXPECT_EQ(cvg8.value_cvp.get_data()->size(), 8u);
+
+  fc4sc::global::delete_context(cntxt);
+}
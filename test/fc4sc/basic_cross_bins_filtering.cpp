@@ -56,7 +56,6 @@ TEST(cross_bins_filtering, binsof) {
 
     basic_cross_bins_filtering_test basic_cg_1("basic_cg_1",__FILE__,__LINE__,cntxt);
 
-    // TODO: update testcase to check the functionality of binsof, || and && operators
     EXPECT_EQ(basic_cg_1.get_inst_coverage(), 0);
 
     basic_cg_1.sample(0, 0);
@@ -95,6 +94,153 @@ TEST(cross_bins_filtering, binsof) {
 
 }
 
+class cross_user_bins_cvg : public covergroup {
+public:
+  int x = 0;
+  int y = 0;
+  CG_CONS(cross_user_bins_cvg) {};
+
+  COVERPOINT(int, cvp1, x) {
+    bin<int>("one", 1),
+    bin<int>("two", 2),
+    bin<int>("three", 3)
+  };
+
+  COVERPOINT(int, cvp2, y) {
+    bin<int>("one", 1),
+    bin<int>("two", 2)
+  };
+
+  // automatic bins: (1,2) and (2,1)
+  cross<int,int> filtered = cross<int,int> (this, "filtered", &cvp1, &cvp2,
+    cross_bin("both_one", binsof<int>(&cvp1, "one") && binsof<int>(&cvp2, "one")),
+    ignore_cross_bin("ignore_three", binsof<int>(&cvp1).intersect(3)),
+    illegal_cross_bin("two_two", binsof<int>(&cvp1).intersect(interval(2,2)) && binsof<int>(&cvp2, "two"))
+  );
+
+  // automatic bins: (2,2) and (3,2)
+  cross<int,int> either = cross<int,int> (this, "either", &cvp1, &cvp2,
+    cross_bin("any_one", binsof<int>(&cvp1).intersect(1) || !binsof<int>(&cvp2, "two"))
+  );
+};
+
+static std::vector<fc4sc::cross_bin_hits> user_bins_of(fc4sc::cross_base& crs)
+{
+  return static_cast<fc4sc::cross_base_data_model*>(crs.get_data())->get_user_bins();
+}
+
+TEST(cross_bins_filtering, user_bins) {
+  auto cntxt = fc4sc::global::create_new_context();
+  cross_user_bins_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  EXPECT_EQ(cvg.filtered.size(), 3u);
+  EXPECT_EQ(cvg.either.size(), 3u);
+
+  cvg.x = 1; cvg.y = 1;
+  cvg.sample();
+  EXPECT_DOUBLE_EQ(cvg.filtered.get_inst_coverage(), 100.0 / 3);
+  EXPECT_DOUBLE_EQ(cvg.either.get_inst_coverage(), 100.0 / 3);
+  EXPECT_TRUE(cvg.filtered.get_cross_bins().empty());
+
+  cvg.x = 1; cvg.y = 2;
+  cvg.sample();
+  EXPECT_DOUBLE_EQ(cvg.filtered.get_inst_coverage(), 200.0 / 3);
+  EXPECT_DOUBLE_EQ(cvg.either.get_inst_coverage(), 100.0 / 3);
+
+  // ignored combinations are misses
+  cvg.x = 3; cvg.y = 1;
+  cvg.sample();
+  EXPECT_DOUBLE_EQ(cvg.filtered.get_inst_coverage(), 200.0 / 3);
+  EXPECT_EQ(cvg.filtered.get_misses(), 1u);
+
+  cvg.x = 3; cvg.y = 2;
+  cvg.sample();
+  EXPECT_DOUBLE_EQ(cvg.either.get_inst_coverage(), 200.0 / 3);
+
+  cvg.x = 2; cvg.y = 2;
+  EXPECT_THROW(cvg.sample(), fc4sc::illegal_bin_sample_exception);
+
+  cvg.x = 2; cvg.y = 1;
+  cvg.sample();
+  EXPECT_EQ(cvg.filtered.get_inst_coverage(), 100);
+
+  auto filtered_bins = user_bins_of(cvg.filtered);
+  ASSERT_EQ(filtered_bins.size(), 3u);
+  EXPECT_EQ(filtered_bins[0].name, "both_one");
+  EXPECT_EQ(filtered_bins[0].hits, 1u);
+  EXPECT_EQ(filtered_bins[1].type, fc4sc::ignore_);
+  EXPECT_EQ(filtered_bins[1].hits, 2u);
+  EXPECT_EQ(filtered_bins[2].type, fc4sc::illegal_);
+  EXPECT_EQ(filtered_bins[2].hits, 1u);
+  EXPECT_EQ(user_bins_of(cvg.either)[0].hits, 4u);
+
+  xml_printer::coverage_save("basic_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()) + ".xml",cntxt);
+  fc4sc::global::delete_context(cntxt);
+}
+
+class cross_precedence_cvg : public covergroup {
+public:
+  int x = 0;
+  int y = 0;
+  CG_CONS(cross_precedence_cvg) {};
+
+  COVERPOINT(int, cvp1, x) {
+    bin<int>("one", 1),
+    bin<int>("two", 2),
+    bin<int>("three", 3)
+  };
+
+  COVERPOINT(int, cvp2, y) {
+    bin<int>("one", 1),
+    bin<int>("two", 2)
+  };
+
+  // the illegal bin is declared last, but still takes precedence
+  cross<int,int> overlapping = cross<int,int> (this, "overlapping", &cvp1, &cvp2,
+    cross_bin("one_any", binsof<int>(&cvp1, "one")),
+    ignore_cross_bin("any_two", binsof<int>(&cvp2, "two")),
+    ignore_cross_bin("one_two", binsof<int>(&cvp1, "one") && binsof<int>(&cvp2, "two")),
+    cross_bin("three_any", binsof<int>(&cvp1).intersect(3)),
+    illegal_cross_bin("three_two", binsof<int>(&cvp1).intersect(3) && binsof<int>(&cvp2, "two"))
+  );
+};
+
+TEST(cross_bins_filtering, precedence) {
+  auto cntxt = fc4sc::global::create_new_context();
+  cross_precedence_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  cvg.x = 1; cvg.y = 1;
+  cvg.sample();
+
+  // both ignore bins count the hit, the regular bin does not
+  cvg.x = 1; cvg.y = 2;
+  cvg.sample();
+  EXPECT_EQ(cvg.overlapping.get_misses(), 1u);
+
+  // the illegal bin counts the hit, the ignore and regular bins do not
+  cvg.x = 3; cvg.y = 2;
+  EXPECT_THROW(cvg.sample(), fc4sc::illegal_bin_sample_exception);
+  EXPECT_EQ(cvg.overlapping.get_misses(), 1u);
+
+  cvg.x = 3; cvg.y = 1;
+  cvg.sample();
+
+  auto bins = user_bins_of(cvg.overlapping);
+  ASSERT_EQ(bins.size(), 5u);
+  EXPECT_EQ(bins[0].name, "one_any");
+  EXPECT_EQ(bins[0].hits, 1u);
+  EXPECT_EQ(bins[1].name, "any_two");
+  EXPECT_EQ(bins[1].hits, 1u);
+  EXPECT_EQ(bins[2].name, "one_two");
+  EXPECT_EQ(bins[2].hits, 1u);
+  EXPECT_EQ(bins[3].name, "three_any");
+  EXPECT_EQ(bins[3].hits, 1u);
+  EXPECT_EQ(bins[4].name, "three_two");
+  EXPECT_EQ(bins[4].hits, 1u);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
 class cross_cvg : public covergroup {
 public:
   int value = 0;
@@ -146,4 +292,22 @@ TEST(cross_bins_filtering, edge_cross) {
 
 }
 
+class cross_foreign_bins_cvg : public covergroup {
+public:
+  int x = 0;
+  CG_CONS(cross_foreign_bins_cvg) {};
+
+  COVERPOINT(int, cvp1, x) { bin<int>("one", 1) };
+  COVERPOINT(int, cvp2, x) { bin<int>("one", 1) };
+  COVERPOINT(int, other, x) { bin<int>("one", 1) };
+
+  cross<int,int> crs = cross<int,int> (this, "crs", &cvp1, &cvp2,
+    cross_bin("foreign", binsof<int>(&other, "one"))
+  );
+};
 
+TEST(cross_bins_filtering, selection_of_coverpoint_not_crossed) {
+  auto cntxt = fc4sc::global::create_new_context();
+  EXPECT_THROW(cross_foreign_bins_cvg("cvg",__FILE__,__LINE__,cntxt), std::string);
+  fc4sc::global::delete_context(cntxt);
+}
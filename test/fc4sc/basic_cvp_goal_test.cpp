@@ -85,3 +85,70 @@ TEST(cvp_options, goal) {
   fc4sc::global::delete_context(cntxt);
 
 }
+
+class stop_at_goal_test : public covergroup {
+public:
+
+  CG_CONS(stop_at_goal_test) {
+    value_cvp.option().stop_at_goal = true;
+    mode_cvp.option().stop_at_goal = true;
+    other_cvp.option().stop_at_goal = true;
+    value_mode.option().stop_at_goal = true;
+    value_mode.option().at_goal_sample_period = 4;
+    value_mode.option().goal = 50;
+  };
+
+  int value = 0;
+  int mode = 0;
+
+  COVERPOINT(int, value_cvp, value) {
+    bin_array<int>("values", 4, interval(0,3))
+  };
+
+  COVERPOINT(int, mode_cvp, mode) {
+    bin<int>("even", 0),
+    bin<int>("odd", 1)
+  };
+
+  // same bins as mode_cvp, but not crossed
+  COVERPOINT(int, other_cvp, mode) {
+    bin<int>("even", 0),
+    bin<int>("odd", 1)
+  };
+
+  cross<int,int> value_mode = cross<int,int>(this, "value_mode", &value_cvp, &mode_cvp);
+};
+
+TEST(cvp_options, stop_at_goal) {
+
+  auto cntxt = fc4sc::global::create_new_context();
+
+  stop_at_goal_test cg("cg",__FILE__,__LINE__,cntxt);
+
+  for (int i = 0; i < 16; ++i) {
+    cg.value = i % 4;
+    cg.mode = i % 2;
+    cg.sample();
+  }
+
+  // stopped after its second sample
+  EXPECT_TRUE(cg.other_cvp.get_data()->sampling_cut);
+  EXPECT_EQ(cg.other_cvp.get_bin_hit_count(0), 1u);
+  EXPECT_EQ(cg.other_cvp.get_bin_hit_count(1), 1u);
+
+  // at goal, but still sampled for the cross
+  EXPECT_TRUE(cg.mode_cvp.get_data()->goal_reached);
+  EXPECT_FALSE(cg.mode_cvp.get_data()->sampling_cut);
+  EXPECT_EQ(cg.mode_cvp.get_bin_hit_count(0), 8u);
+  EXPECT_EQ(cg.value_cvp.get_bin_hit_count(3), 4u);
+
+  // 4 samples to reach the goal, then one sample in 4 of the next 12
+  uint64_t cross_hits = 0;
+  for (auto& bin : cg.value_mode.get_cross_bins())
+    cross_hits += bin.second;
+  EXPECT_TRUE(cg.value_mode.get_data()->sampling_cut);
+  EXPECT_EQ(cross_hits, 4u + 3);
+
+  xml_printer::coverage_save("basic_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()) + ".xml", cntxt);
+  fc4sc::global::delete_context(cntxt);
+}
@@ -123,3 +123,130 @@ TEST(flat_map,slice) {
   fc4sc::global::delete_context(cntxt);
 
 }
+
+class overlap_cross_test : public covergroup {
+public:
+  CG_CONS(overlap_cross_test) { }
+
+  int a = 0;
+  int b = 0;
+
+  COVERPOINT(int, cvp_a, a) {
+    bin<int>("low", interval(0,5)),
+    bin<int>("mid", interval(3,8)),
+    bin<int>("high", interval(6,9))
+  };
+
+  COVERPOINT(int, cvp_b, b) {
+    bin<int>("x", interval(0,1)),
+    bin<int>("y", interval(1,2))
+  };
+
+  cross<int,int> a_b = cross<int,int>(this, "a_b", &cvp_a, &cvp_b);
+};
+
+TEST(bin_overlap,cross) {
+  auto cntxt = fc4sc::global::create_new_context();
+  overlap_cross_test cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  // low and mid crossed with x and y
+  cvg.a = 4;
+  cvg.b = 1;
+  cvg.sample();
+
+  // tuples list the bin of cvp_b first
+  std::map<std::vector<size_t>, uint64_t> expected = {
+    {{0,0},1}, {{0,1},1}, {{1,0},1}, {{1,1},1}
+  };
+  EXPECT_EQ(cvg.a_b.get_cross_bins(), expected);
+  EXPECT_DOUBLE_EQ(cvg.a_b.get_inst_coverage(), 100.0 * 4 / 6);
+
+  // only the first combination, (y, mid), is counted
+  cvg.a_b.option().max_hit_combinations = 1;
+  cvg.a = 7;
+  cvg.b = 2;
+  cvg.sample();
+  expected[{1,1}] = 2;
+  EXPECT_EQ(cvg.a_b.get_cross_bins(), expected);
+  EXPECT_EQ(cvg.a_b.get_data()->truncated_samples, 1u);
+
+  cvg.a_b.option().max_hit_combinations = 2;
+  cvg.sample();
+  expected[{1,1}] = 3;
+  expected[{1,2}] = 1;
+  EXPECT_EQ(cvg.a_b.get_cross_bins(), expected);
+  EXPECT_DOUBLE_EQ(cvg.a_b.get_inst_coverage(), 100.0 * 5 / 6);
+
+  xml_printer::coverage_save("bin_overlap_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()) + ".xml",cntxt);
+  fc4sc::global::delete_context(cntxt);
+}
+
+class hit_caps_test : public covergroup {
+public:
+  CG_CONS(hit_caps_test) { }
+
+  int a = 0;
+  int b = 0;
+
+  // every bin holds 5
+  COVERPOINT(int, wide, a) {
+    bin<int>("w0", interval(0,9)), bin<int>("w1", interval(1,9)),
+    bin<int>("w2", interval(2,9)), bin<int>("w3", interval(3,9)),
+    bin<int>("w4", interval(4,9)), bin<int>("w5", interval(5,9)),
+    bin<int>("w6", interval(0,5)), bin<int>("w7", interval(1,5)),
+    bin<int>("w8", interval(2,5)), bin<int>("w9", interval(3,5))
+  };
+
+  COVERPOINT(int, narrow, b) {
+    bin<int>("x", interval(0,1)),
+    bin<int>("y", interval(1,2))
+  };
+
+  cross<int,int> wide_narrow = cross<int,int>(this, "wide_narrow", &wide, &narrow);
+};
+
+TEST(bin_overlap, hit_caps) {
+  auto cntxt = fc4sc::global::create_new_context();
+  hit_caps_test cvg("cvg",__FILE__,__LINE__,cntxt);
+  cvg.wide_narrow.option().max_hit_combinations = 10;
+
+  cvg.a = 5;
+  cvg.b = 1;
+  testing::internal::CaptureStderr();
+  cvg.sample();
+  cvg.sample();
+  std::string report = testing::internal::GetCapturedStderr();
+
+  // the coverpoint counts all 10 bins, the cross only combines the first
+  // FC4SC_MAX_HIT_BINS of them, and only max_hit_combinations combinations
+  for (uint32_t i = 0; i < 10; ++i)
+    EXPECT_EQ(cvg.wide.get_bin_hit_count(i), 2u);
+  uint64_t crossed = 0;
+  cvg.wide_narrow.for_each_cross_bin([&crossed](const size_t*, uint64_t count) { crossed += count; });
+  EXPECT_EQ(crossed, 20u);
+
+  EXPECT_EQ(cvg.wide.get_data()->truncated_samples, 2u);
+  EXPECT_EQ(cvg.narrow.get_data()->truncated_samples, 0u);
+  EXPECT_EQ(cvg.wide_narrow.get_data()->truncated_samples, 2u);
+
+  // reported once per object
+  EXPECT_EQ(report, "Warning: wide hit more than FC4SC_MAX_HIT_BINS bins in one sample, "
+                    "crosses only combine the first ones\n"
+                    "Warning: wide_narrow hit more than option.max_hit_combinations bins in one sample, "
+                    "the others are not counted\n");
+
+  // 16 combinations, within the limit
+  cvg.wide_narrow.option().max_hit_combinations = 16;
+  cvg.sample();
+  EXPECT_EQ(cvg.wide_narrow.get_data()->truncated_samples, 2u);
+
+  std::string file_name = "bin_overlap_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()) + ".xml";
+  xml_printer::coverage_save(file_name, cntxt);
+  std::ifstream file(file_name);
+  std::stringstream xml;
+  xml << file.rdbuf();
+  EXPECT_NE(xml.str().find("<userAttr key=\"truncatedSamples\" type=\"int\">3</userAttr>"), std::string::npos);
+  EXPECT_NE(xml.str().find("<userAttr key=\"truncatedSamples\" type=\"int\">2</userAttr>"), std::string::npos);
+
+  fc4sc::global::delete_context(cntxt);
+}
@@ -0,0 +1,184 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+
+/*
+ * Built into main.exe, and by the Makefile once per build mode:
+ * -DNDEBUG -DFC4SC_UNCHECKED, -DNDEBUG -DFC4SC_CHECK_PER_COVERGROUP and
+ * -DFC4SC_ATOMIC_COUNTERS. Every mode must count the hits computed here.
+ */
+
+#include <thread>
+#include "fc4sc.hpp"
+#include "gtest/gtest.h"
+
+// Values read by the sample expressions, private to each sampling thread
+static thread_local int opcode = 0;
+static thread_local int operand = 0;
+
+class build_mode_cvg : public covergroup {
+public:
+  CG_CONS(build_mode_cvg) { }
+
+  COVERPOINT(int, opcode_cvp, opcode) {
+    bin_array<int>("op", 16, interval(0,15))
+  };
+
+  COVERPOINT(int, operand_cvp, operand, opcode != 15) {
+    bin<int>("zero", 0),
+    bin_array<int>("small", 4, interval(1,64)),
+    bin<int>("large", interval(65,255))
+  };
+
+  cross<int,int> opcode_operand = cross<int,int>(this, "opcode_operand", &opcode_cvp, &operand_cvp);
+};
+
+class counted_cvg : public covergroup {
+public:
+  CG_CONS(counted_cvg) { }
+
+  uint64_t condition_calls = 0;
+  uint64_t expression_calls = 0;
+
+  bool count_condition() { ++condition_calls; return opcode != 15; }
+  int count_expression() { ++expression_calls; return operand; }
+
+  COVERPOINT(int, counted_cvp, count_expression(), count_condition()) {
+    bin<int>("zero", 0)
+  };
+};
+
+/*! Hits expected from a build_mode_cvg */
+struct reference_counts {
+  uint64_t opcode[16] = {};
+  uint64_t operand[6] = {};
+  uint64_t cross[16][6] = {};
+  uint64_t samples = 0;
+};
+
+/*! Sets the values of the next sample of the sequence in state x */
+static void set_values(uint32_t& x)
+{
+  x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+  opcode = x & 15;
+  operand = (x >> 4) & 255;
+}
+
+/*! Samples cvg n times from seed and adds the expected hits to ref */
+static void sample_loop(build_mode_cvg& cvg, uint32_t seed, size_t n, reference_counts& ref)
+{
+  uint32_t x = 2463534242u + seed;
+  for (size_t i = 0; i < n; ++i) {
+    set_values(x);
+    cvg.sample();
+    ref.samples++;
+    ref.opcode[opcode]++;
+    if (opcode == 15) continue;
+    size_t bin = (operand == 0) ? 0 : (operand <= 64) ? 1 + (operand - 1) / 16 : 5;
+    ref.operand[bin]++;
+    ref.cross[opcode][bin]++;
+  }
+}
+
+/*! Checks the hits counted by cvg against ref */
+static void expect_counts(build_mode_cvg& cvg, const reference_counts& ref)
+{
+  for (uint32_t i = 0; i < 16; ++i)
+    EXPECT_EQ(cvg.opcode_cvp.get_bin_hit_count(i), ref.opcode[i]);
+  for (uint32_t i = 0; i < 6; ++i)
+    EXPECT_EQ(cvg.operand_cvp.get_bin_hit_count(i), ref.operand[i]);
+  uint64_t cross_total = 0;
+  // the cross holds its coverpoints in reverse order of declaration
+  cvg.opcode_operand.for_each_cross_bin([&](const size_t* idx, uint64_t count) {
+    EXPECT_EQ(count, ref.cross[idx[1]][idx[0]]);
+    cross_total += count;
+  });
+  EXPECT_EQ(cross_total, ref.samples - ref.opcode[15]);
+}
+
+TEST(build_modes, counts) {
+  auto cntxt = fc4sc::global::create_new_context();
+  build_mode_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+  reference_counts ref;
+
+  sample_loop(cvg, 1, 10000, ref);
+  expect_counts(cvg, ref);
+  // opcode 15 does not sample the operand: 90 of the 96 cross bins are hit
+  EXPECT_DOUBLE_EQ(cvg.get_inst_coverage(), (200 + 100.0 * 90 / 96) / 3);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(build_modes, sample_expression_calls) {
+  auto cntxt = fc4sc::global::create_new_context();
+  counted_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  // the expression is only evaluated when the condition holds
+  uint32_t x = 1;
+  uint64_t accepted = 0;
+  for (int i = 0; i < 1000; ++i) {
+    set_values(x);
+    accepted += (opcode != 15);
+    cvg.sample();
+  }
+  EXPECT_EQ(cvg.condition_calls, 1000u);
+  EXPECT_EQ(cvg.expression_calls, accepted);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+#if FC4SC_CHECK_ON_CVG_SAMPLE
+TEST(build_modes, deleted_data) {
+  auto cntxt = fc4sc::global::create_new_context();
+  build_mode_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+  cvg.sample();
+  fc4sc::global::delete_context(cntxt);
+
+  EXPECT_ANY_THROW(cvg.sample());
+#if FC4SC_CHECK_ON_MEMBER_SAMPLE
+  EXPECT_ANY_THROW(cvg.opcode_cvp.sample());
+#endif
+}
+#endif
+
+#ifdef FC4SC_ATOMIC_COUNTERS
+TEST(build_modes, concurrent_sampling) {
+  auto cntxt = fc4sc::global::create_new_context();
+  build_mode_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  // every thread samples the same instance, without shards or locks
+  const size_t threads = 4;
+  std::vector<reference_counts> refs(threads);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t)
+    workers.emplace_back([&cvg, &refs, t]() { sample_loop(cvg, t, 20000, refs[t]); });
+  for (auto& w : workers) w.join();
+
+  reference_counts ref;
+  for (auto& r : refs) {
+    ref.samples += r.samples;
+    for (int i = 0; i < 16; ++i) {
+      ref.opcode[i] += r.opcode[i];
+      for (int j = 0; j < 6; ++j) ref.cross[i][j] += r.cross[i][j];
+    }
+    for (int j = 0; j < 6; ++j) ref.operand[j] += r.operand[j];
+  }
+  expect_counts(cvg, ref);
+
+  fc4sc::global::delete_context(cntxt);
+}
+#endif
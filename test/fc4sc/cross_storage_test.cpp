@@ -0,0 +1,329 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+#include "fc4sc.hpp"
+#include "gtest/gtest.h"
+
+typedef std::map<std::vector<size_t>, uint64_t> tuple_counts;
+
+static tuple_counts contents(const fc4sc::cross_bin_storage& storage)
+{
+  tuple_counts result;
+  storage.for_each([&](const size_t* idx, uint64_t count) {
+    result[std::vector<size_t>(idx, idx + storage.arity())] = count;
+  });
+  return result;
+}
+
+TEST(cross_storage, layouts) {
+  const std::vector<uint64_t> radix = { 3, 5, 7 };
+  const size_t tuples[][3] = { {0,0,0}, {2,4,6}, {1,3,0}, {2,4,6}, {0,4,1} };
+
+  fc4sc::cross_bin_storage dense, hashed, tree;
+  dense.reshape(radix, 1024);
+  hashed.reshape(radix, 0);
+  tree.reshape({ uint64_t(1) << 32, uint64_t(1) << 32, 8 }, 1024);
+  EXPECT_EQ(dense.layout, fc4sc::cross_bin_storage::dense_layout);
+  EXPECT_EQ(dense.dense.size(), 105u);
+  EXPECT_EQ(hashed.layout, fc4sc::cross_bin_storage::hashed_layout);
+  EXPECT_EQ(tree.layout, fc4sc::cross_bin_storage::tree_layout);
+
+  for (auto& t : tuples) {
+    ++*dense.insert(t);
+    ++*hashed.insert(t);
+    ++*tree.insert(t);
+  }
+
+  tuple_counts expected = { {{0,0,0},1}, {{0,4,1},1}, {{1,3,0},1}, {{2,4,6},2} };
+  EXPECT_EQ(contents(dense), expected);
+  EXPECT_EQ(contents(hashed), expected);
+  EXPECT_EQ(contents(tree), expected);
+
+  const size_t outside[] = { 3, 0, 0 };
+  EXPECT_EQ(dense.insert(outside), nullptr);
+  EXPECT_EQ(hashed.find_dense(tuples[0]), nullptr);
+}
+
+TEST(cross_storage, reshape_keeps_counts) {
+  fc4sc::cross_bin_storage storage;
+  storage.reshape({ 2, 2 }, 1024);
+  const size_t a[] = { 1, 1 };
+  const size_t b[] = { 0, 1 };
+  *storage.insert(a) += 3;
+  *storage.insert(b) += 1;
+
+  // grow into the hashed layout, past the initial hash table size
+  storage.reshape({ 100, 100 }, 64);
+  ASSERT_EQ(storage.layout, fc4sc::cross_bin_storage::hashed_layout);
+  for (size_t i = 0; i < 50; ++i) {
+    const size_t c[] = { i, 99 - i };
+    ++*storage.insert(c);
+  }
+
+  tuple_counts result = contents(storage);
+  EXPECT_EQ(result.size(), 52u);
+  EXPECT_EQ((result[{1,1}]), 3u);
+  EXPECT_EQ((result[{0,1}]), 1u);
+  EXPECT_EQ((result[{49,50}]), 1u);
+}
+
+TEST(cross_storage, bitmap_layout) {
+  const std::vector<uint64_t> radix = { uint64_t(1) << 20, uint64_t(1) << 20 };
+  fc4sc::cross_bin_storage bitmap, hashed;
+  bitmap.reshape(radix, 0, 0);
+  hashed.reshape(radix, 0);
+  ASSERT_EQ(bitmap.layout, fc4sc::cross_bin_storage::bitmap_layout);
+  ASSERT_EQ(hashed.layout, fc4sc::cross_bin_storage::hashed_layout);
+
+  // enough keys in the first container to turn it into a bitmap, a few
+  // scattered ones, and some keys hit more than once
+  for (size_t i = 0; i < 5000; ++i) {
+    const size_t t[] = { 0, i * 7 % 6000 };
+    EXPECT_EQ(bitmap.add(t), hashed.add(t));
+  }
+  for (size_t i = 0; i < 100; ++i) {
+    const size_t t[] = { i * 7919 % (1 << 20), i * 104729 % (1 << 20) };
+    EXPECT_EQ(bitmap.add(t, i % 3 + 1), hashed.add(t, i % 3 + 1));
+  }
+  EXPECT_TRUE(bitmap.bitmap.begin()->second.array.empty());
+  EXPECT_EQ(contents(bitmap), contents(hashed));
+
+  const size_t twice[] = { 0, 7 };
+  const size_t never[] = { 5, 5 };
+  bitmap.add(twice);
+  EXPECT_EQ(bitmap.count(twice), 2u);
+  EXPECT_EQ(bitmap.count(never), 0u);
+  EXPECT_EQ(bitmap.insert(twice), nullptr);
+
+  // memory follows the hit keys: one table slot per key hit more than once
+  EXPECT_LT(bitmap.slot_keys.size(), hashed.slot_keys.size());
+
+  // a wider layout keeps the counts
+  bitmap.reshape({ uint64_t(1) << 21, uint64_t(1) << 21 }, 0, 0);
+  hashed.add(twice);
+  EXPECT_EQ(contents(bitmap), contents(hashed));
+}
+
+class cross_storage_cvg : public covergroup {
+public:
+  CG_CONS(cross_storage_cvg, uint dense_bytes = 0) {
+    a_b.option().dense_bins_max_bytes = dense_bytes;
+  }
+
+  int a = 0;
+  int b = 0;
+
+  COVERPOINT(int, a_cvp, a) {
+    bin_array<int>("a", 8, interval(0,7))
+  };
+
+  COVERPOINT(int, b_cvp, b) {
+    bin_array<int>("b", 4, interval(0,3))
+  };
+
+  cross<int,int> a_b = cross<int,int>(this, "a_b", &a_cvp, &b_cvp);
+};
+
+TEST(cross_storage, dense_and_hashed_cross_match) {
+  auto cntxt = fc4sc::global::create_new_context();
+  cross_storage_cvg dense("dense",__FILE__,__LINE__,cntxt,1024);
+  cross_storage_cvg hashed("hashed",__FILE__,__LINE__,cntxt,0);
+
+  for (int i = 0; i < 40; ++i) {
+    dense.a = hashed.a = (i * 5) % 9;
+    dense.b = hashed.b = i % 4;
+    dense.sample();
+    hashed.sample();
+  }
+
+  auto dense_bins = dense.a_b.get_cross_bins();
+  EXPECT_EQ(dense_bins, hashed.a_b.get_cross_bins());
+  EXPECT_EQ(dense.a_b.get_misses(), hashed.a_b.get_misses());
+  EXPECT_EQ(dense.a_b.get_inst_coverage(), hashed.a_b.get_inst_coverage());
+
+  // a bin added to a crossed coverpoint widens the cross storage. Tuples
+  // list the bin indexes in reverse coverpoint order
+  bin<int>("eight", 8).add_to_cvp(dense.a_cvp);
+  dense.a = 8;
+  dense.b = 3;
+  dense.sample();
+  auto grown_bins = dense.a_b.get_cross_bins();
+  EXPECT_EQ(grown_bins.size(), dense_bins.size() + 1);
+  EXPECT_EQ((grown_bins[{3,8}]), 1u);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(cross_storage, for_each_cross_bin) {
+  auto cntxt = fc4sc::global::create_new_context();
+  cross_storage_cvg cvg("cvg",__FILE__,__LINE__,cntxt,1024);
+
+  cvg.set_shards(2);
+  for (int i = 0; i < 40; ++i) {
+    fc4sc::set_thread_shard(i % 2);
+    cvg.a = i % 8;
+    cvg.b = i % 3;
+    cvg.sample();
+  }
+  fc4sc::set_thread_shard(0);
+
+  // each bin is visited once, with its counts of both shards
+  std::map<std::vector<size_t>, uint64_t> visited;
+  cvg.a_b.for_each_cross_bin([&visited](const size_t* idx, uint64_t count) {
+    EXPECT_TRUE(visited.emplace(std::vector<size_t>(idx, idx + 2), count).second);
+  });
+  auto bins = cvg.a_b.get_cross_bins();
+  ASSERT_EQ(visited.size(), bins.size());
+  for (auto& it : bins)
+    EXPECT_EQ(visited[it.first], it.second);
+
+  cvg.set_shards(1);
+  EXPECT_EQ(cvg.a_b.get_cross_bins(), bins);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(cross_storage, missing_bins) {
+  auto cntxt = fc4sc::global::create_new_context();
+  cross_storage_cvg dense("dense",__FILE__,__LINE__,cntxt,1024);
+  cross_storage_cvg hashed("hashed",__FILE__,__LINE__,cntxt,0);
+
+  // nothing sampled: every tuple is missing, in key order
+  std::vector<std::vector<size_t>> first = { {0,0}, {0,1}, {0,2} };
+  EXPECT_EQ(dense.a_b.get_missing_bins(3), first);
+
+  for (int a = 0; a < 8; ++a) {
+    dense.a = hashed.a = a;
+    dense.b = hashed.b = a % 4;
+    dense.sample();
+    hashed.sample();
+  }
+  dense.sample();
+  hashed.sample();
+
+  std::vector<std::vector<size_t>> missing = dense.a_b.get_missing_bins(100);
+  EXPECT_EQ(missing.size(), 32u - 8u);
+  EXPECT_EQ(missing, hashed.a_b.get_missing_bins(100));
+  first = { {0,1}, {0,2}, {0,3} };
+  EXPECT_EQ(dense.a_b.get_missing_bins(3), first);
+
+  // with at_least 2 only the tuple sampled twice, (3,7), is covered
+  dense.a_b.option().at_least = 2;
+  missing = dense.a_b.get_missing_bins(100);
+  EXPECT_EQ(missing.size(), 31u);
+  EXPECT_EQ(std::count(missing.begin(), missing.end(), std::vector<size_t>{3,7}), 0);
+
+  std::stringstream report;
+  dense.a_b.option().cross_num_print_missing = 1;
+  dense.a_b.print_missing(report);
+  EXPECT_EQ(report.str(), "Missing bins of cross a_b:\n  b_cvp.b[0] x a_cvp.a[0]\n");
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+class large_cross_cvg : public covergroup {
+public:
+  CG_CONS(large_cross_cvg) { }
+
+  int a = 0;
+  int b = 0;
+
+  COVERPOINT(int, a_cvp, a) {
+    bin_array<int>("a", 4096, interval(0,4095))
+  };
+
+  COVERPOINT(int, b_cvp, b) {
+    bin_array<int>("b", 4096, interval(0,4095))
+  };
+
+  cross<int,int> a_b = cross<int,int>(this, "a_b", &a_cvp, &b_cvp);
+};
+
+TEST(cross_storage, missing_bins_of_large_cross) {
+  auto cntxt = fc4sc::global::create_new_context();
+  large_cross_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+  cvg.a_b.option().dense_bins_max_bytes = 0;
+
+  cvg.b = 0;
+  for (int a = 0; a < 4095; ++a) {
+    cvg.a = a;
+    cvg.sample();
+  }
+
+  // the first holes are found past the covered tuples, out of 16M
+  std::vector<std::vector<size_t>> first = { {0,4095}, {1,0}, {1,1} };
+  EXPECT_EQ(cvg.a_b.get_missing_bins(3), first);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+class huge_cross_cvg : public covergroup {
+public:
+  CG_CONS(huge_cross_cvg) { }
+
+  int a = 0;
+  int b = 0;
+  int c = 0;
+
+  COVERPOINT(int, a_cvp, a) {
+    bin_array<int>("a", 2048, interval(0,2047))
+  };
+
+  COVERPOINT(int, b_cvp, b) {
+    bin_array<int>("b", 2048, interval(0,2047))
+  };
+
+  COVERPOINT(int, c_cvp, c) {
+    bin_array<int>("c", 2048, interval(0,2047))
+  };
+
+  cross<int,int,int> a_b_c = cross<int,int,int>(this, "a_b_c", &a_cvp, &b_cvp, &c_cvp);
+};
+
+TEST(cross_storage, huge_cross) {
+  auto cntxt = fc4sc::global::create_new_context();
+  huge_cross_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  for (int i = 0; i < 1000; ++i) {
+    cvg.a = i;
+    cvg.b = (i * 3) % 2048;
+    cvg.c = (i * 7) % 2048;
+    cvg.sample();
+    cvg.sample();
+  }
+
+  const uint64_t bins = uint64_t(2048) * 2048 * 2048;
+  uint64_t covered = 0, total = 0;
+  cvg.a_b_c.get_inst_coverage(covered, total);
+  EXPECT_EQ(total, bins);
+  EXPECT_EQ(covered, 1000u);
+  EXPECT_DOUBLE_EQ(cvg.a_b_c.get_inst_coverage(), 100.0 * 1000 / bins);
+  EXPECT_EQ(cvg.a_b_c.get_cross_bins().size(), 1000u);
+  EXPECT_EQ((cvg.a_b_c.get_cross_bins().at({7,3,1})), 2u);
+
+  cvg.get_inst_coverage(covered, total);
+  EXPECT_EQ(total, bins + 3 * 2048);
+  EXPECT_EQ(covered, 1000u + 3 * 1000);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(cross_storage, int_counts_saturate) {
+  EXPECT_EQ(fc4sc::saturate_to_int(12), 12);
+  EXPECT_EQ(fc4sc::saturate_to_int(uint64_t(INT_MAX)), INT_MAX);
+  EXPECT_EQ(fc4sc::saturate_to_int(uint64_t(1) << 40), INT_MAX);
+}
@@ -294,6 +294,63 @@ v1 = -1;
 
 }
 
+TEST(dynamic_covergroup, runtime_cross_test) {
+  //Dynamic Declaration
+  fc4sc::dynamic_covergroup_factory cvg("cvg");
+  auto cvg_a = cvg.create_coverpoint<int(int)>("a",[](int x) {return x;});
+  cvg_a.create_bin("ZERO",0);
+  cvg_a.create_bin("ONE",1);
+
+  auto cvg_b = cvg.create_coverpoint<unsigned(int)>("b",[](int x) {return x % 3;});
+  cvg_b.create_bin("ZERO",0u);
+  cvg_b.create_bin("ONE",1u);
+  cvg_b.create_bin("TWO",2u);
+
+  auto cvg_c = cvg.create_coverpoint<int(int)>("c",[](int x) {return x / 2;});
+  cvg_c.create_bin("LOW",interval(0,1));
+  cvg_c.create_bin("HIGH",interval(2,3));
+
+  // the same cross, declared with types and at runtime
+  cvg.add_cross("typed_cross",cvg_a,cvg_b);
+  cvg.add_cross("runtime_cross",{"a","b"});
+  cvg.add_cross("three_cross",{"a","b","c"});
+  EXPECT_THROW(cvg.add_cross("bad_cross",{"a","d"}), std::string);
+
+  //Dynamic Instantiation
+  auto cntxt = fc4sc::global::create_new_context();
+
+  int v1, v2, v3;
+  fc4sc::dynamic_covergroup inst(cvg,"runtime_cross_inst",__FILE__,__LINE__,cntxt);
+  cvg_a.bind_sample(inst,v1);
+  cvg_b.bind_sample(inst,v2);
+  cvg_c.bind_sample(inst,v3);
+
+  for (int i = 0; i < 5; ++i) {
+    v1 = i % 2;
+    v2 = i;
+    v3 = i;
+    inst.sample();
+  }
+
+  auto& typed = static_cast<fc4sc::cross_base&>(inst.get_coverpoint("typed_cross"));
+  auto& runtime = static_cast<fc4sc::cross_base&>(inst.get_coverpoint("runtime_cross"));
+  auto& three = static_cast<fc4sc::cross_base&>(inst.get_coverpoint("three_cross"));
+  EXPECT_EQ(runtime.get_cross_bins(), typed.get_cross_bins());
+  EXPECT_EQ(runtime.get_inst_coverage(), typed.get_inst_coverage());
+  EXPECT_EQ(runtime.size(), 6u);
+
+  // tuples list the bins of c, b, a; only i = 4 hits HIGH
+  std::map<std::vector<size_t>, uint64_t> expected = {
+    {{0,0,0},1}, {{0,1,1},1}, {{0,2,0},1}, {{0,0,1},1}, {{1,1,0},1}
+  };
+  EXPECT_EQ(three.get_cross_bins(), expected);
+  EXPECT_EQ(three.size(), 12u);
+  EXPECT_DOUBLE_EQ(three.get_inst_coverage(), 100.0 * 5 / 12);
+
+  xml_printer::coverage_save("dynamic_covergroup_"+std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()) + ".xml",cntxt);
+  fc4sc::global::delete_context(cntxt);
+}
+
 TEST(dynamic_covergroup, bin_array1) {
   //Dynamic Declaration
   fc4sc::dynamic_covergroup_factory cvg("cvg");
@@ -432,3 +489,91 @@ TEST(dynamic_covergroup, scope_test_no_condition) {
   fc4sc::global::delete_context(cntxt);
 
 }
+
+TEST(dynamic_covergroup, shared_schema) {
+  fc4sc::dynamic_covergroup_factory cvg("cvg");
+  auto cvg_sum = cvg.create_coverpoint<int(int,int)>("sum",[](int x, int y) {return x+y;});
+  cvg_sum.create_bin("ZERO",0);
+  cvg_sum.create_illegal_bin("BAD",7);
+  cvg_sum.create_bin("ONE",1);
+
+  auto cntxt = fc4sc::global::create_new_context();
+  int v1 = 0, v2 = 0;
+  fc4sc::dynamic_covergroup inst1(cvg,"inst1",__FILE__,__LINE__,cntxt);
+  fc4sc::dynamic_covergroup inst2(cvg,"inst2",__FILE__,__LINE__,cntxt);
+  cvg_sum.bind_sample(inst1,v1,v2);
+  cvg_sum.bind_sample(inst2,v1,v2);
+
+  // the instances share the bin definitions but not the counters
+  auto data1 = static_cast<fc4sc::coverpoint_data_model*>(inst1.cvg_base::get_coverpoint("sum").get_data());
+  auto data2 = static_cast<fc4sc::coverpoint_data_model*>(inst2.cvg_base::get_coverpoint("sum").get_data());
+  ASSERT_EQ(data1->bins_data.size(), 2u);
+  for (size_t i = 0; i < data1->bins_data.size(); ++i) {
+    auto bin1 = static_cast<fc4sc::bin_data_model<int>*>(data1->bins_data[i]);
+    auto bin2 = static_cast<fc4sc::bin_data_model<int>*>(data2->bins_data[i]);
+    EXPECT_NE(bin1, bin2);
+    EXPECT_EQ(bin1->definition, bin2->definition);
+  }
+  EXPECT_EQ(data1->bins_data[1]->get_name(), "ONE");
+
+  v1 = 1;
+  inst1.sample();
+  EXPECT_EQ(inst1.get_inst_coverage(), 50);
+  EXPECT_EQ(inst2.get_inst_coverage(), 0);
+  v1 = 0;
+  inst2.sample();
+  inst2.sample();
+  EXPECT_EQ(data1->bins_data[0]->get_interval_hits()[0], 0u);
+  EXPECT_EQ(data2->bins_data[0]->get_interval_hits()[0], 2u);
+  EXPECT_EQ(data2->bins_data[1]->get_interval_hits()[0], 0u);
+
+  // a bin added to the factory only changes the later instances
+  cvg_sum.create_bin("TWO",2);
+  fc4sc::dynamic_covergroup inst3(cvg,"inst3",__FILE__,__LINE__,cntxt);
+  cvg_sum.bind_sample(inst3,v1,v2);
+  v1 = 2;
+  inst1.sample();
+  inst3.sample();
+  EXPECT_EQ(inst1.get_inst_coverage(), 50);
+  EXPECT_NEAR(inst3.get_inst_coverage(), 100.0 / 3, 0.01);
+  EXPECT_ANY_THROW({ v1 = 7; inst3.sample(); });
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(dynamic_covergroup, coverpoint_handles) {
+  fc4sc::dynamic_covergroup_factory cvg("cvg");
+  auto cvg_a = cvg.create_coverpoint<int(int)>("a",[](int x) {return x;});
+  auto cvg_b = cvg.create_coverpoint<int(int)>("b",[](int x) {return x;});
+  cvg_b.create_bin("ONE",1);
+  fc4sc::dynamic_covergroup_factory other("other");
+  other.create_coverpoint<int(int)>("c",[](int x) {return x;});
+  other.create_coverpoint<int(int)>("b",[](int x) {return x;});
+
+  auto cntxt = fc4sc::global::create_new_context();
+  std::vector<std::unique_ptr<fc4sc::dynamic_covergroup>> insts;
+  std::vector<int> values(64, 1);
+  for (size_t i = 0; i < values.size(); ++i) {
+    insts.emplace_back(new fc4sc::dynamic_covergroup(cvg,"inst" + std::to_string(i),__FILE__,__LINE__,cntxt));
+    cvg_a.bind_sample(*insts[i], values[i]);
+    cvg_b.bind_sample(*insts[i], values[i]);
+  }
+  insts[3]->sample();
+  EXPECT_EQ(&cvg_b.instance(*insts[3]), &insts[3]->get_coverpoint("b"));
+  EXPECT_EQ(cvg_b.instance(*insts[3]).get_bin_hit_count(0), 1u);
+  EXPECT_EQ(cvg_b.instance(*insts[4]).get_bin_hit_count(0), 0u);
+
+  // covergroups of another type are searched by name
+  fc4sc::dynamic_covergroup other_inst(other,"other_inst",__FILE__,__LINE__,cntxt);
+  EXPECT_EQ(&cvg_b.instance(other_inst), &other_inst.get_coverpoint("b"));
+  EXPECT_ANY_THROW(cvg_a.instance(other_inst));
+
+  EXPECT_EQ(insts[0]->find_coverpoint("c"), nullptr);
+  EXPECT_ANY_THROW(insts[0]->get_coverpoint("c"));
+  insts[0]->get_coverpoint("a").name() = "c";
+  EXPECT_EQ(insts[0]->find_coverpoint("a"), nullptr);
+  EXPECT_EQ(&insts[0]->get_coverpoint("c"), &cvg_a.instance(*insts[0]));
+
+  insts.clear();
+  fc4sc::global::delete_context(cntxt);
+}
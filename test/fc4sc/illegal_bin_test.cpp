@@ -61,3 +61,89 @@ TEST(illegal_bin, sample_throws) {
   EXPECT_EQ(cvg.get_inst_coverage(), 100);
   fc4sc::global::delete_context(cntxt);  
 }
+
+/*! Sets the illegal bin policy for the life of a test */
+struct illegal_policy_guard {
+  fc4sc::illegal_bin_policy saved;
+  illegal_policy_guard(fc4sc::illegal_bin_action action,
+                       std::function<void(const fc4sc::illegal_bin_hit&)> callback = nullptr)
+    : saved(fc4sc::illegal_bins_policy()) {
+    fc4sc::set_illegal_bin_policy(action, callback);
+  }
+  ~illegal_policy_guard() {
+    fc4sc::illegal_bins_policy() = saved;
+  }
+};
+
+TEST(illegal_bin, policy_count) {
+  illegal_policy_guard guard(fc4sc::illegal_bin_action::count);
+  auto cntxt = fc4sc::global::create_new_context();
+  cvg_illegal_test cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  EXPECT_NO_THROW(cvg.sample(2));
+  EXPECT_NO_THROW(cvg.sample(2));
+  cvg.sample(3);
+
+  EXPECT_EQ(cvg.cvp1.get_illegal_bins_base()[0]->get_hitcount(), 2u);
+  EXPECT_EQ(cvg.cvp1.get_misses(), 1u);
+  EXPECT_EQ(cvg.get_inst_coverage(), 0);
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(illegal_bin, policy_callback) {
+  std::vector<std::string> hits;
+  illegal_policy_guard guard(fc4sc::illegal_bin_action::callback,
+    [&hits](const fc4sc::illegal_bin_hit& hit) {
+      EXPECT_EQ(hit.cvp_name, "cvp1");
+      EXPECT_EQ(hit.bin_name, "illegal_2");
+      EXPECT_EQ(hit.value(), "2");
+      ASSERT_NE(hit.cvg_name, nullptr);
+      EXPECT_EQ(*hit.cvg_name, "cvg");
+      hits.push_back(hit.message());
+    });
+  auto cntxt = fc4sc::global::create_new_context();
+  cvg_illegal_test cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  cvg.sample(1);
+  EXPECT_NO_THROW(cvg.sample(2));
+
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_NE(hits[0].find("illegal_2"), std::string::npos);
+  EXPECT_EQ(cvg.cvp1.get_illegal_bins_base()[0]->get_hitcount(), 1u);
+  EXPECT_EQ(cvg.cvp1.get_misses(), 0u);
+  EXPECT_EQ(cvg.get_inst_coverage(), 100);
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(illegal_bin, policy_report) {
+  illegal_policy_guard guard(fc4sc::illegal_bin_action::report);
+  auto cntxt = fc4sc::global::create_new_context();
+  cvg_illegal_test cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  testing::internal::CaptureStderr();
+  EXPECT_NO_THROW(cvg.sample(2));
+  std::string report = testing::internal::GetCapturedStderr();
+
+  EXPECT_NE(report.find("illegal_2"), std::string::npos);
+  EXPECT_EQ(cvg.cvp1.get_illegal_bins_base()[0]->get_hitcount(), 1u);
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(illegal_bin, policy_callback_async) {
+  illegal_policy_guard guard(fc4sc::illegal_bin_action::callback,
+    [](const fc4sc::illegal_bin_hit& hit) {
+      throw std::runtime_error(hit.message());
+    });
+  auto cntxt = fc4sc::global::create_new_context();
+  cvg_illegal_test cvg("cvg",__FILE__,__LINE__,cntxt);
+  ASSERT_TRUE(cvg.set_async_sampling(16));
+
+  // thrown on the worker, rethrown on the sampling thread
+  cvg.sample(2);
+  EXPECT_THROW(cvg.drain_samples(), std::runtime_error);
+
+  cvg.sample(1);
+  cvg.drain_samples();
+  EXPECT_EQ(cvg.get_inst_coverage(), 100);
+  fc4sc::global::delete_context(cntxt);
+}
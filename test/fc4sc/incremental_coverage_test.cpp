@@ -0,0 +1,170 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+#include "fc4sc.hpp"
+#include "gtest/gtest.h"
+
+class incremental_cvg : public covergroup {
+public:
+  CG_CONS(incremental_cvg) { }
+
+  int a = 0;
+  int b = 0;
+
+  COVERPOINT(int, a_cvp, a) {
+    bin<int>("zero", 0),
+    bin<int>("small", interval(1,3), interval(5,6)),
+    bin<int>("big", 100)
+  };
+
+  COVERPOINT(int, b_cvp, b) {
+    bin<int>("zero", 0),
+    bin<int>("one", 1)
+  };
+
+  cross<int,int> a_b = cross<int,int>(this, "a_b", &a_cvp, &b_cvp);
+};
+
+TEST(incremental_coverage, at_least) {
+  auto cntxt = fc4sc::global::create_new_context();
+  incremental_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  EXPECT_EQ(cvg.a_cvp.get_inst_coverage(), 0);
+  for (int v : { 0, 2, 5, 0 }) {
+    cvg.a = v;
+    cvg.sample();
+  }
+  // zero and small are both hit twice
+  EXPECT_DOUBLE_EQ(cvg.a_cvp.get_inst_coverage(), 200.0 / 3);
+  EXPECT_DOUBLE_EQ(cvg.a_b.get_inst_coverage(), 200.0 / 6);
+
+  cvg.a_cvp.option().at_least = 2;
+  cvg.a_b.option().at_least = 2;
+  EXPECT_DOUBLE_EQ(cvg.a_cvp.get_inst_coverage(), 200.0 / 3);
+  EXPECT_DOUBLE_EQ(cvg.a_b.get_inst_coverage(), 200.0 / 6);
+
+  cvg.a_cvp.option().at_least = 3;
+  EXPECT_EQ(cvg.a_cvp.get_inst_coverage(), 0);
+  cvg.a = 6;
+  cvg.sample();
+  EXPECT_DOUBLE_EQ(cvg.a_cvp.get_inst_coverage(), 100.0 / 3);
+
+  cvg.a_cvp.option().at_least = 0;
+  cvg.a_b.option().at_least = 0;
+  EXPECT_EQ(cvg.a_cvp.get_inst_coverage(), 100);
+  cvg.b = 1;
+  cvg.sample();
+  EXPECT_DOUBLE_EQ(cvg.a_b.get_inst_coverage(), 50);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(incremental_coverage, new_bins) {
+  auto cntxt = fc4sc::global::create_new_context();
+  incremental_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  cvg.b = 1;
+  cvg.sample();
+  EXPECT_EQ(cvg.b_cvp.get_inst_coverage(), 50);
+
+  bin<int>("two", 2).add_to_cvp(cvg.b_cvp);
+  EXPECT_DOUBLE_EQ(cvg.b_cvp.get_inst_coverage(), 100.0 / 3);
+  cvg.b = 2;
+  cvg.sample();
+  EXPECT_DOUBLE_EQ(cvg.b_cvp.get_inst_coverage(), 200.0 / 3);
+  double expected = (100.0 / 3 + 200.0 / 3 + 200.0 / 9) / 3;
+  EXPECT_DOUBLE_EQ(cvg.get_inst_coverage(), expected);
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), expected);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(incremental_coverage, cached_queries) {
+  auto cntxt = fc4sc::global::create_new_context();
+  incremental_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+  const std::string scp_type = cvg.scp_type_name();
+  fc4sc::coverage_cache& cache = fc4sc::global::get_coverage_cache(cntxt);
+
+  cvg.sample();
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 100.0 / 3);
+  EXPECT_FALSE(cache.changed);
+
+  // no new bin covered, the coverage is not recomputed
+  cvg.sample();
+  EXPECT_FALSE(cache.changed);
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 100.0 / 3);
+
+  cvg.a = 2;
+  cvg.sample();
+  EXPECT_TRUE(cache.changed);
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 50);
+
+  // options changed through the accessors are seen by the next query
+  cvg.option().goal = 40;
+  EXPECT_EQ(fc4sc::global::get_coverage(cntxt), 100);
+  cvg.option().goal = 100;
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 50);
+
+  // and so are options written through a reference kept from an accessor
+  cvg_option& options = cvg.option();
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 50);
+  options.goal = 40;
+  EXPECT_EQ(fc4sc::global::get_coverage(cntxt), 100);
+  options.goal = 100;
+  cvp_option& a_options = cvg.a_cvp.option();
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 50);
+  a_options.weight = 0;
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), (50 + 100.0 / 3) / 2);
+  a_options.weight = 1;
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 50);
+  cross_option& a_b_options = cvg.a_b.option();
+  a_b_options.at_least = 2;
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), (200.0 / 3 + 50 + 100.0 / 6) / 3);
+  a_b_options.at_least = 1;
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 50);
+
+  // reading the options does not mark the coverage as changed
+  EXPECT_EQ(cvg.option().goal + a_options.weight + a_b_options.at_least, 102u);
+  EXPECT_FALSE(cache.changed);
+
+  incremental_cvg other("other",__FILE__,__LINE__,cntxt);
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 25);
+  uint64_t hit = 0, total = 0;
+  fc4sc::global::get_coverage(scp_type, "incremental_cvg", hit, total, cntxt);
+  EXPECT_EQ(hit, 5u);
+  EXPECT_EQ(total, 22u);
+
+  cvg_type_option& type_options = fc4sc::global::type_option(scp_type, "incremental_cvg", cntxt);
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 25);
+  type_options.weight = 0;
+  EXPECT_EQ(fc4sc::global::get_coverage(cntxt), 0);
+  type_options.weight = 1;
+
+  // sharded sampling is not marked, the instance is recomputed on every query
+  other.set_shards(2);
+  fc4sc::set_thread_shard(1);
+  other.sample();
+  fc4sc::set_thread_shard(0);
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), (50 + 100.0 / 3) / 2);
+  other.a = 100;
+  other.sample();
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 50);
+  other.set_shards(1);
+  EXPECT_DOUBLE_EQ(fc4sc::global::get_coverage(cntxt), 50);
+
+  fc4sc::global::delete_context(cntxt);
+}
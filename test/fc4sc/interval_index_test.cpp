@@ -0,0 +1,183 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+#include "fc4sc.hpp"
+#include "gtest/gtest.h"
+
+TEST(interval_index, find) {
+  typedef std::pair<unsigned int, unsigned int> bin_range_t;
+  std::map<fc4sc::interval_t<int>, std::vector<bin_range_t>> ranges;
+  ranges[interval(-10,-5)] = { {0,0} };
+  ranges[interval(1,1)] = { {1,0}, {2,0} };
+  ranges[interval(3,9)] = { {2,1} };
+
+  fc4sc::interval_index<int> idx;
+  EXPECT_EQ(idx.find(0), fc4sc::interval_index<int>::npos);
+
+  idx.build(ranges);
+  EXPECT_EQ(idx.find(-11), fc4sc::interval_index<int>::npos);
+  EXPECT_EQ(idx.find(-10), 0u);
+  EXPECT_EQ(idx.find(-5), 0u);
+  EXPECT_EQ(idx.find(0), fc4sc::interval_index<int>::npos);
+  EXPECT_EQ(idx.find(1), 1u);
+  EXPECT_EQ(idx.find(2), fc4sc::interval_index<int>::npos);
+  EXPECT_EQ(idx.find(3), 2u);
+  EXPECT_EQ(idx.find(9), 2u);
+  EXPECT_EQ(idx.find(10), fc4sc::interval_index<int>::npos);
+
+  EXPECT_EQ(idx.refs_end(1) - idx.refs_begin(1), 2);
+  EXPECT_EQ(idx.refs_begin(1)[1].bin, 2u);
+  EXPECT_EQ(idx.refs_begin(2)->interval, 1u);
+}
+
+TEST(interval_index, merged_maps) {
+  typedef std::pair<unsigned int, unsigned int> bin_range_t;
+  std::map<fc4sc::interval_t<int>, std::vector<bin_range_t>> ignore, illegal, regular;
+  regular[interval(0,99)] = { {0,0} };
+  ignore[interval(10,19)] = { {0,0} };
+  illegal[interval(15,24)] = { {0,0} };
+
+  fc4sc::interval_index<int> idx;
+  idx.build(ignore, illegal, regular);
+  ASSERT_EQ(idx.upper.size(), 5u);
+
+  // [10,14] ignore + regular, [15,19] all three, [20,24] illegal + regular
+  size_t pos = idx.find(17);
+  ASSERT_EQ(idx.refs_end(pos) - idx.refs_begin(pos), 3);
+  EXPECT_EQ(idx.refs_begin(pos)[0].type, fc4sc::ignore_);
+  EXPECT_EQ(idx.refs_begin(pos)[1].type, fc4sc::illegal_);
+  EXPECT_EQ(idx.refs_begin(pos)[2].type, fc4sc::default_);
+  EXPECT_EQ(idx.find(12), idx.find(10));
+  EXPECT_NE(idx.find(12), idx.find(15));
+  EXPECT_EQ(idx.refs_begin(idx.find(22))->type, fc4sc::illegal_);
+  EXPECT_EQ(idx.find(100), fc4sc::interval_index<int>::npos);
+}
+
+class index_rebuild_cvg : public covergroup {
+public:
+  CG_CONS(index_rebuild_cvg) { }
+
+  unsigned char val = 0;
+
+  COVERPOINT(unsigned char, cvp, val) {
+    bin<unsigned char>("low", interval(0,9)),
+    bin<unsigned char>("high", interval(200,255))
+  };
+};
+
+TEST(interval_index, rebuild_on_new_bin) {
+  auto cntxt = fc4sc::global::create_new_context();
+  index_rebuild_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  cvg.val = 255;
+  cvg.sample();
+  cvg.val = 100;
+  cvg.sample();
+  EXPECT_EQ(cvg.cvp.get_bin_hit_count(1), 1u);
+  EXPECT_EQ(cvg.cvp.get_misses(), 1u);
+
+  // adding a bin after sampling started must be visible to the next sample
+  bin<unsigned char>("middle", interval(50,150)).add_to_cvp(cvg.cvp);
+  cvg.sample();
+  EXPECT_EQ(cvg.cvp.get_bin_hit_count(2), 1u);
+  EXPECT_EQ(cvg.cvp.get_misses(), 1u);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(interval_index, dense_matches_search) {
+  typedef std::pair<unsigned int, unsigned int> bin_range_t;
+  std::map<fc4sc::interval_t<int8_t>, std::vector<bin_range_t>> ranges;
+  ranges[interval<int8_t>(-128,-100)] = { {0,0} };
+  ranges[interval<int8_t>(-3,0)] = { {1,0} };
+  ranges[interval<int8_t>(5,5)] = { {2,0} };
+  ranges[interval<int8_t>(7,127)] = { {3,0} };
+
+  fc4sc::interval_index<int8_t> sparse;
+  fc4sc::interval_index<int8_t> dense;
+  sparse.build(ranges);
+  dense.build(ranges, 1024);
+  EXPECT_TRUE(sparse.dense.empty());
+  ASSERT_EQ(dense.dense.size(), 256u);
+
+  for (int v = -128; v <= 127; ++v)
+    EXPECT_EQ(dense.find(v), sparse.find(v)) << "value " << v;
+
+  // a limit below the domain size keeps the binary search
+  fc4sc::interval_index<int8_t> limited;
+  limited.build(ranges, 1023);
+  EXPECT_TRUE(limited.dense.empty());
+}
+
+class dense_lookup_cvg : public covergroup {
+public:
+  CG_CONS(dense_lookup_cvg) { }
+
+  bool flag = false;
+  uint16_t opcode = 0;
+
+  COVERPOINT(bool, flag_cvp, flag) {
+    bin<bool>("low", false),
+    bin<bool>("high", true)
+  };
+
+  COVERPOINT(uint16_t, opcode_cvp, opcode) {
+    bin<uint16_t>("nop", 0),
+    bin_array<uint16_t>("alu", 4, interval<uint16_t>(0x10,0x1f)),
+    ignore_bin<uint16_t>("reserved", interval<uint16_t>(0x1000,0xffff))
+  };
+};
+
+TEST(interval_index, dense_lookup_sampling) {
+  auto cntxt = fc4sc::global::create_new_context();
+  dense_lookup_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  cvg.flag = true;
+  cvg.opcode = 0x13;
+  cvg.sample();
+  cvg.opcode = 0xffff;
+  cvg.sample();
+  cvg.opcode = 0x20;
+  cvg.sample();
+
+  EXPECT_EQ(cvg.flag_cvp.get_bin_hit_count(1), 3u);
+  EXPECT_EQ(cvg.flag_cvp.get_inst_coverage(), 50);
+  EXPECT_EQ(cvg.opcode_cvp.get_bin_hit_count(1), 1u);
+  EXPECT_EQ(cvg.opcode_cvp.get_misses(), 2u);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+TEST(interval_index, counter_arena) {
+  auto cntxt = fc4sc::global::create_new_context();
+  dense_lookup_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  for (uint16_t op : { 0x0, 0x10, 0x11, 0x1f, 0x2000 }) {
+    cvg.opcode = op;
+    cvg.sample();
+  }
+
+  // nop, alu[0..3] and reserved share one counter array, in declaration order
+  auto data = static_cast<fc4sc::coverpoint_base_data_model*>(cvg.opcode_cvp.get_data());
+  std::vector<uint64_t> expected = { 1, 2, 0, 0, 1, 1 };
+  EXPECT_EQ(data->hit_counters, expected);
+  data->create_bins_data();
+  EXPECT_EQ(data->bins_data[1]->get_interval_hits()[0], 2u);
+  EXPECT_EQ(data->ignore_bins_data[0]->get_interval_hits().size(), 1u);
+
+  fc4sc::global::delete_context(cntxt);
+}
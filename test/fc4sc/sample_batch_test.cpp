@@ -0,0 +1,245 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+#include "fc4sc.hpp"
+#include "gtest/gtest.h"
+
+class batch_cvg : public covergroup {
+public:
+  CG_CONS(batch_cvg) {
+    // exercise the linear and binary searches instead of the dense tables
+    small_cvp.option().dense_lookup_max_bytes = 0;
+    wide_cvp.option().dense_lookup_max_bytes = 0;
+  }
+
+  int value = 0;
+  int flag = 0;
+
+  COVERPOINT(int, small_cvp, value) {
+    bin<int>("zero", 0),
+    bin_array<int>("low", 4, interval(1,20)),
+    ignore_bin<int>("ignored", 7),
+    bin<int>("overlap", interval(15,30))
+  };
+
+  COVERPOINT(int, wide_cvp, value) {
+    bin_array<int>("ranges", 40, interval(-1000,1000)),
+    bin<int>("max", 1000000)
+  };
+
+  COVERPOINT(int, flag_cvp, flag) {
+    bin<int>("off", 0),
+    bin<int>("on", 1)
+  };
+
+  cross<int,int> value_flag = cross<int,int>(this, "value_flag", &small_cvp, &flag_cvp);
+};
+
+TEST(sample_batch, coverpoint_matches_scalar) {
+  auto cntxt = fc4sc::global::create_new_context();
+  batch_cvg scalar("scalar",__FILE__,__LINE__,cntxt);
+  batch_cvg batched("batched",__FILE__,__LINE__,cntxt);
+
+  std::vector<int> values;
+  for (int i = -1200; i <= 1200; i += 7) values.push_back(i);
+  for (int i = -5; i <= 40; ++i) values.push_back(i);
+  values.push_back(1000000);
+
+  for (auto v : values) {
+    scalar.value = v;
+    scalar.sample();
+  }
+  batched.small_cvp.sample_batch(values.data(), values.size());
+  batched.wide_cvp.sample_batch(values.data(), values.size());
+
+  for (uint32_t i = 0; i < scalar.small_cvp.size(); ++i)
+    EXPECT_EQ(batched.small_cvp.get_bin_hit_count(i), scalar.small_cvp.get_bin_hit_count(i));
+  for (uint32_t i = 0; i < scalar.wide_cvp.size(); ++i)
+    EXPECT_EQ(batched.wide_cvp.get_bin_hit_count(i), scalar.wide_cvp.get_bin_hit_count(i));
+  EXPECT_EQ(batched.small_cvp.get_misses(), scalar.small_cvp.get_misses());
+  EXPECT_EQ(batched.wide_cvp.get_misses(), scalar.wide_cvp.get_misses());
+  EXPECT_EQ(batched.small_cvp.get_illegal_bins_base().size(), 0u);
+  EXPECT_EQ(batched.small_cvp.get_ignore_bins_base()[0]->get_hitcount(), 1u);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+struct batch_txn {
+  int value;
+  int flag;
+};
+
+TEST(sample_batch, covergroup) {
+  auto cntxt = fc4sc::global::create_new_context();
+  batch_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  batch_txn txns[] = { {0,0}, {0,1}, {3,1}, {7,0}, {100,1} };
+  cvg.sample_batch(txns, 5, [&cvg](const batch_txn& t) {
+    cvg.value = t.value;
+    cvg.flag = t.flag;
+  });
+
+  EXPECT_EQ(cvg.small_cvp.get_bin_hit_count(0), 2u);
+  EXPECT_EQ(cvg.small_cvp.get_bin_hit_count(1), 1u);
+  EXPECT_EQ(cvg.small_cvp.get_misses(), 2u);
+  EXPECT_EQ(cvg.flag_cvp.get_bin_hit_count(1), 3u);
+  EXPECT_EQ(cvg.value_flag.get_cross_bins().size(), 3u);
+  EXPECT_EQ(cvg.value_flag.get_misses(), 2u);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+class batch_cond_cvg : public covergroup {
+public:
+  CG_CONS(batch_cond_cvg) {}
+
+  int value = 0;
+  int flag = 0;
+
+  COVERPOINT(int, value_cvp, value, flag != 2) {
+    bin_array<int>("values", 8, interval(0,15)),
+    ignore_bin<int>("ignored", 3)
+  };
+
+  COVERPOINT(int, flag_cvp, flag) {
+    bin<int>("off", 0),
+    bin<int>("on", 1)
+  };
+
+  cross<int,int> value_flag = cross<int,int>(this, "value_flag", &value_cvp, &flag_cvp);
+};
+
+TEST(sample_batch, covergroup_matches_scalar) {
+  auto cntxt = fc4sc::global::create_new_context();
+  batch_cond_cvg scalar("scalar",__FILE__,__LINE__,cntxt);
+  batch_cond_cvg batched("batched",__FILE__,__LINE__,cntxt);
+
+  // several blocks, the last one partial
+  std::vector<batch_txn> txns;
+  for (int i = 0; i < 300; ++i) txns.push_back(batch_txn{ i % 20, i % 3 });
+
+  for (auto& t : txns) {
+    scalar.value = t.value;
+    scalar.flag = t.flag;
+    scalar.sample();
+  }
+  batched.sample_batch(txns.data(), txns.size(), [&batched](const batch_txn& t) {
+    batched.value = t.value;
+    batched.flag = t.flag;
+  });
+
+  for (uint32_t i = 0; i < scalar.value_cvp.size(); ++i)
+    EXPECT_EQ(batched.value_cvp.get_bin_hit_count(i), scalar.value_cvp.get_bin_hit_count(i));
+  EXPECT_EQ(batched.value_cvp.get_misses(), scalar.value_cvp.get_misses());
+  EXPECT_EQ(batched.flag_cvp.get_bin_hit_count(1), scalar.flag_cvp.get_bin_hit_count(1));
+  EXPECT_EQ(batched.value_flag.get_cross_bins(), scalar.value_flag.get_cross_bins());
+  EXPECT_EQ(batched.value_flag.get_misses(), scalar.value_flag.get_misses());
+  EXPECT_EQ(batched.get_inst_coverage(), scalar.get_inst_coverage());
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+class plan_cvg : public covergroup {
+public:
+  CG_CONS(plan_cvg) {}
+
+  int value = 0;
+  bool flag = false;
+
+  COVERPOINT(int, first_cvp, value) {
+    bin<int>("low", interval(0,9)),
+    bin<int>("high", interval(10,19))
+  };
+
+  COVERPOINT(bool, flag_cvp, flag) {
+    bin<bool>("off", false),
+    bin<bool>("on", true)
+  };
+
+  cross<int,bool> early_cross = cross<int,bool>(this, "early_cross", &first_cvp, &flag_cvp);
+
+  // sampled after early_cross, before late_cross
+  COVERPOINT(int, late_cvp, value * 2) {
+    bin<int>("even", interval(0,38)),
+    illegal_bin<int>("too_big", 1000)
+  };
+
+  cross<int,int> late_cross = cross<int,int>(this, "late_cross", &late_cvp, &first_cvp);
+};
+
+TEST(sample_batch, sampling_plan) {
+  auto cntxt = fc4sc::global::create_new_context();
+  plan_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  for (int i = 0; i < 20; ++i) {
+    cvg.value = i;
+    cvg.flag = (i % 2) == 1;
+    cvg.sample();
+  }
+
+  EXPECT_EQ(cvg.first_cvp.get_bin_hit_count(0), 10u);
+  EXPECT_EQ(cvg.late_cvp.get_bin_hit_count(0), 20u);
+  EXPECT_EQ(cvg.early_cross.get_cross_bins().size(), 4u);
+  EXPECT_EQ(cvg.late_cross.get_cross_bins().size(), 2u);
+  EXPECT_EQ(cvg.late_cross.get_misses(), 0u);
+
+  // an illegal bin still stops the covergroup sample
+  cvg.value = 500;
+  EXPECT_THROW(cvg.sample(), fc4sc::illegal_bin_sample_exception);
+  EXPECT_EQ(cvg.late_cross.get_misses(), 0u);
+
+  fc4sc::global::delete_context(cntxt);
+}
+
+static std::vector<int> sample_order;
+
+/*! Records that the sample expression of coverpoint id was evaluated */
+static int record_sample(int id)
+{
+  sample_order.push_back(id);
+  return id;
+}
+
+class order_cvg : public covergroup {
+public:
+  CG_CONS(order_cvg) {}
+
+  COVERPOINT(int, a_cvp, record_sample(0)) {
+    bin<int>("a", 0)
+  };
+
+  COVERPOINT(bool, b_cvp, record_sample(1) == 1) {
+    bin<bool>("b", true)
+  };
+
+  COVERPOINT(int, c_cvp, record_sample(2)) {
+    bin<int>("c", 2)
+  };
+};
+
+TEST(sample_batch, sampling_order) {
+  auto cntxt = fc4sc::global::create_new_context();
+  order_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+
+  // declaration order, although a_cvp and c_cvp have the same type
+  sample_order.clear();
+  cvg.sample();
+  cvg.sample();
+  EXPECT_EQ(sample_order, std::vector<int>({0, 1, 2, 0, 1, 2}));
+
+  fc4sc::global::delete_context(cntxt);
+}
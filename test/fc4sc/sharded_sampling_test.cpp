@@ -0,0 +1,85 @@
+/******************************************************************************
+
+   Copyright 2020 NVIDIA Corporation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+******************************************************************************/
+#include "fc4sc.hpp"
+#include "xml_printer.hpp"
+#include "gtest/gtest.h"
+
+#include <thread>
+
+static thread_local int sharded_value = 0;
+static thread_local int sharded_mode = 0;
+
+class sharded_cvg : public covergroup {
+public:
+  CG_CONS(sharded_cvg) { }
+
+  COVERPOINT(int, value_cvp, sharded_value) {
+    bin_array<int>("values", 8, interval(0,7)),
+    ignore_bin<int>("ignored", 100)
+  };
+
+  COVERPOINT(int, mode_cvp, sharded_mode) {
+    bin<int>("even", 0),
+    bin<int>("odd", 1)
+  };
+
+  cross<int,int> value_mode = cross<int,int>(this, "value_mode", &value_cvp, &mode_cvp);
+};
+
+TEST(sharded_sampling, threads) {
+  auto cntxt = fc4sc::global::create_new_context();
+  sharded_cvg cvg("cvg",__FILE__,__LINE__,cntxt);
+  cvg.set_shards(4);
+
+  const int samples = 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread([&cvg, t]() {
+      fc4sc::set_thread_shard(t);
+      for (int i = 0; i < samples; ++i) {
+        // each thread only sees values 2t and 2t+1, plus misses
+        sharded_value = (i % 3 == 2) ? 50 + t : 2 * t + (i % 3);
+        sharded_mode = t % 2;
+        cvg.sample();
+      }
+    }));
+  }
+  for (auto& thread : threads) thread.join();
+
+  for (int t = 0; t < 4; ++t) {
+    EXPECT_EQ(cvg.value_cvp.get_bin_hit_count(2 * t), 334u);
+    EXPECT_EQ(cvg.value_cvp.get_bin_hit_count(2 * t + 1), 333u);
+  }
+  EXPECT_EQ(cvg.value_cvp.get_misses(), 4u * 333);
+  EXPECT_EQ(cvg.value_cvp.get_inst_coverage(), 100);
+  EXPECT_EQ(cvg.mode_cvp.get_bin_hit_count(1), 2u * samples);
+
+  // values 2t, 2t+1 crossed with mode t % 2
+  EXPECT_EQ(cvg.value_mode.get_cross_bins().size(), 8u);
+  EXPECT_EQ(cvg.value_mode.get_misses(), 4u * 333);
+  EXPECT_EQ(cvg.value_mode.get_inst_coverage(), 50);
+
+  // the merged counts survive disabling the sharding
+  cvg.set_shards(1);
+  EXPECT_EQ(cvg.value_cvp.get_bin_hit_count(7), 333u);
+  EXPECT_EQ(cvg.value_mode.get_cross_bins().size(), 8u);
+  EXPECT_EQ(cvg.value_mode.get_inst_coverage(), 50);
+
+  xml_printer::coverage_save("sharded_sampling.xml", cntxt);
+  fc4sc::global::delete_context(cntxt);
+}